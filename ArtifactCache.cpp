@@ -0,0 +1,125 @@
+#include "ArtifactCache.h"
+#include "MappedFile.h"
+#include "Platform.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    char const Magic[4] = { 'Z', 'C', 'A', '1' };
+
+    // Layout: magic, source hash, block count, then the size and bytes of every block.
+    // Integers are written in host order, artifacts aren't meant to move between endians.
+    bool ReadValue(FILE* file, uint64_t& value)
+    {
+        return fread(&value, sizeof(value), 1, file) == 1;
+    }
+
+    bool WriteValue(FILE* file, uint64_t value)
+    {
+        return fwrite(&value, sizeof(value), 1, file) == 1;
+    }
+}
+
+ArtifactCache::ArtifactCache(std::string const& dir)
+    : Dir(dir)
+{
+    Platform::MakeDirectory(Dir.c_str());
+}
+
+bool ArtifactCache::Load(std::string const& key, uint64_t sourceHash, size_t blockCount, std::vector<CodecBuffer>& blocks) const
+{
+    std::string path = GetPath(key, sourceHash);
+    size_t fileSize = 0;
+    if (!MappedFile::GetFileSize(path.c_str(), fileSize))
+        return false;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char magic[sizeof(Magic)];
+    uint64_t hash = 0;
+    uint64_t count = 0;
+    bool valid = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, Magic, sizeof(Magic)) == 0
+        && ReadValue(file, hash) && hash == sourceHash
+        && ReadValue(file, count) && count == blockCount;
+
+    if (valid)
+    {
+        // a damaged size must not get as far as resize, nothing can be larger than what's left
+        uint64_t left = fileSize - sizeof(Magic) - 2 * sizeof(uint64_t);
+        blocks.resize(blockCount);
+        for (size_t i = 0; i < blockCount && valid; ++i)
+        {
+            uint64_t size = 0;
+            valid = left >= sizeof(size) && ReadValue(file, size) && size <= left - sizeof(size);
+            if (valid)
+            {
+                left -= sizeof(size) + size;
+                blocks[i].resize((size_t)size);
+                valid = size == 0 || fread(blocks[i].data(), (size_t)size, 1, file) == 1;
+            }
+        }
+    }
+
+    fclose(file);
+
+    if (!valid)
+        fprintf(stderr, "warning: ignoring damaged artifact %s\n", path.c_str());
+    return valid;
+}
+
+void ArtifactCache::Store(std::string const& key, uint64_t sourceHash, std::vector<CodecBuffer> const& blocks) const
+{
+    // written under a unique name first so concurrent runs never read half a file
+    std::string path = GetPath(key, sourceHash);
+    std::string temporary = path + ".tmp" + std::to_string((uintptr_t)&blocks);
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+        fprintf(stderr, "couldn't write %s\n", temporary.c_str());
+        return;
+    }
+
+    bool written = fwrite(Magic, sizeof(Magic), 1, file) == 1
+        && WriteValue(file, sourceHash)
+        && WriteValue(file, blocks.size());
+    for (size_t i = 0; i < blocks.size() && written; ++i)
+    {
+        written = WriteValue(file, blocks[i].size())
+            && (blocks[i].empty() || fwrite(blocks[i].data(), blocks[i].size(), 1, file) == 1);
+    }
+
+    fclose(file);
+
+    // rename doesn't replace on windows, an existing artifact is as good as this one
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+        remove(temporary.c_str());
+}
+
+uint64_t ArtifactCache::Hash(char const* data, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string ArtifactCache::GetPath(std::string const& key, uint64_t sourceHash) const
+{
+    char hash[24];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)sourceHash);
+
+    // codec names like LZO1X-999/9 aren't all valid file names
+    std::string name = key;
+    for (char& c : name)
+    {
+        if (strchr("/\\:*?\"<>|", c))
+            c = '_';
+    }
+    return Dir + "/" + name + "-" + hash + ".zca";
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "PageAllocator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed output kept on disk between runs, so decompression passes can start from
+// artifacts made once (or by another build) instead of compressing in every setup.
+// Files are named after the codec settings and a hash of the uncompressed input.
+class ArtifactCache
+{
+public:
+    ArtifactCache(std::string const& dir);
+
+    // False if there's no artifact for key and source, or it doesn't hold blockCount blocks.
+    bool Load(std::string const& key, uint64_t sourceHash, size_t blockCount, std::vector<CodecBuffer>& blocks) const;
+    void Store(std::string const& key, uint64_t sourceHash, std::vector<CodecBuffer> const& blocks) const;
+
+    // 64-bit FNV-1a, chain calls by passing the previous result as hash.
+    static uint64_t const HashSeed = 14695981039346656037ull;
+    static uint64_t Hash(char const* data, size_t size, uint64_t hash = HashSeed);
+
+private:
+    std::string GetPath(std::string const& key, uint64_t sourceHash) const;
+
+    std::string Dir;
+};
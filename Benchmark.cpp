@@ -0,0 +1,1565 @@
+#include "Benchmark.h"
+#include "CompressionTests.h"
+#include "DictionaryTrainer.h"
+#include "LatencyHistogram.h"
+#include "MemoryTracker.h"
+#include "PerfCounters.h"
+#include "Platform.h"
+#include "ResultsFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    typedef chrono::steady_clock Clock;
+
+    // Reusable rendezvous point so every scaling thread starts its timed pass together.
+    class ThreadBarrier
+    {
+    public:
+        ThreadBarrier(unsigned count)
+            : Count(count)
+            , Waiting(0)
+            , Generation(0)
+        {
+        }
+
+        void Wait()
+        {
+            unique_lock<mutex> lock(Mutex);
+            unsigned generation = Generation;
+            if (++Waiting == Count)
+            {
+                Waiting = 0;
+                ++Generation;
+                Condition.notify_all();
+            }
+            else
+            {
+                Condition.wait(lock, [this, generation] { return generation != Generation; });
+            }
+        }
+
+    private:
+        mutex Mutex;
+        condition_variable Condition;
+        unsigned const Count;
+        unsigned Waiting;
+        unsigned Generation;
+    };
+
+    void Split(char const* list, vector<string>& values)
+    {
+        string value;
+        for (char const* i = list; ; ++i)
+        {
+            if (*i == ',' || *i == 0)
+            {
+                if (!value.empty())
+                    values.push_back(value);
+                value.clear();
+
+                if (*i == 0)
+                    break;
+            }
+            else
+            {
+                value += *i;
+            }
+        }
+    }
+
+    // Plain byte count with an optional K or M suffix, 0 if it doesn't parse.
+    size_t ParseSize(string const& size)
+    {
+        char* suffix = nullptr;
+        size_t value = strtoul(size.c_str(), &suffix, 10);
+        if (*suffix == 'K' || *suffix == 'k')
+            value *= 1024;
+        else if (*suffix == 'M' || *suffix == 'm')
+            value *= 1024 * 1024;
+        else if (*suffix != 0)
+            return 0;
+        return value;
+    }
+
+    // Nearest rank percentile of sorted samples.
+    double Percentile(vector<double> const& sorted, double fraction)
+    {
+        size_t rank = (size_t)ceil(fraction * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    // Two sided 95% critical value of Student's t, iteration counts are usually too small
+    // for the normal approximation.
+    double StudentT95(size_t degrees)
+    {
+        static double const table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+        size_t const count = sizeof(table) / sizeof(table[0]);
+        return degrees <= count ? table[degrees - 1] : 1.96;
+    }
+
+    // Welch's t-test at 95%, the two runs can have different iteration counts and variance.
+    bool IsSignificant(vector<double> const& a, vector<double> const& b)
+    {
+        if (a.size() < 2 || b.size() < 2)
+            return false;
+
+        auto meanVariance = [](vector<double> const& samples, double& mean, double& variance)
+        {
+            mean = 0;
+            for (double sample : samples)
+                mean += sample;
+            mean /= samples.size();
+
+            variance = 0;
+            for (double sample : samples)
+                variance += (sample - mean) * (sample - mean);
+            variance /= samples.size() - 1;
+        };
+
+        double meanA, varianceA, meanB, varianceB;
+        meanVariance(a, meanA, varianceA);
+        meanVariance(b, meanB, varianceB);
+
+        double errorA = varianceA / a.size();
+        double errorB = varianceB / b.size();
+        if (errorA + errorB == 0)
+            return meanA != meanB;
+
+        double t = fabs(meanA - meanB) / sqrt(errorA + errorB);
+        double degrees = (errorA + errorB) * (errorA + errorB)
+            / (errorA * errorA / (a.size() - 1) + errorB * errorB / (b.size() - 1));
+        return t > StudentT95(max((size_t)degrees, (size_t)1));
+    }
+
+    string FormatValue(double value)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.10g", value);
+        return buffer;
+    }
+
+    string EscapeCsv(string const& value)
+    {
+        if (value.find_first_of(",\"\n") == string::npos)
+            return value;
+
+        string escaped = "\"";
+        for (char c : value)
+        {
+            if (c == '"')
+                escaped += '"';
+            escaped += c;
+        }
+        return escaped + '"';
+    }
+
+    // Single threaded rows of the plain passes, the ones a level sweep is compared on.
+    bool IsOneShot(BenchmarkResult const& result)
+    {
+        return (result.Pass == "compression" || result.Pass == "decompression") && result.GetMetric("threads") <= 1;
+    }
+
+    // Compressed size over input size for every codec and file, looked up from the compression
+    // rows since decompression rows only know their output size.
+    map<pair<string, string>, double> CompressedRatios(vector<BenchmarkResult> const& results)
+    {
+        map<pair<string, string>, double> ratios;
+        for (auto const& result : results)
+        {
+            if (result.Pass == "compression" && IsOneShot(result))
+                ratios[make_pair(result.Codec, result.File)] = result.GetMetric("ratio");
+        }
+        return ratios;
+    }
+
+    string EscapeJson(string const& value)
+    {
+        string escaped;
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                escaped += buffer;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+}
+
+bool BenchmarkOptions::Parse(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+        CommandLine += (i > 1 ? " " : "") + string(argv[i]);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        char const* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg == "--list")
+            List = true;
+        else if (arg == "--chart")
+            Chart = true;
+        else if (arg == "--perf")
+            Perf = true;
+        else if (arg == "--stream-flush")
+            StreamFlush = true;
+        else if (arg == "--sweep")
+            Sweep = true;
+        else if (arg == "--lzo")
+            Lzo = true;
+        else if (arg == "--cold")
+            Cold = true;
+        else if (arg == "--mmap")
+            Mmap = true;
+        else if (arg == "--prefault")
+            Mapping.Prefault = true;
+        else if (arg == "--help" || arg == "-h")
+            return false;
+        else if (!value)
+        {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        else
+        {
+            ++i;
+            if (arg == "--codec")
+                Split(value, Codecs);
+            else if (arg == "--pass")
+                Split(value, Passes);
+            else if (arg == "--data")
+                DataDirs.push_back(value);
+            else if (arg == "--file")
+                Files.push_back(value);
+            else if (arg == "--iterations")
+                Iterations = atoi(value);
+            else if (arg == "--warmup")
+                Warmup = atoi(value);
+            else if (arg == "--pin")
+                PinCore = atoi(value);
+            else if (arg == "--block-sizes")
+            {
+                vector<string> sizes;
+                Split(value, sizes);
+                for (string const& size : sizes)
+                {
+                    size_t blockSize = ParseSize(size);
+                    if (blockSize == 0)
+                    {
+                        fprintf(stderr, "bad block size %s\n", size.c_str());
+                        return false;
+                    }
+                    BlockSizes.push_back(blockSize);
+                }
+            }
+            else if (arg == "--messages")
+            {
+                vector<string> sizes;
+                Split(value, sizes);
+                MessageMin = sizes.size() == 2 ? ParseSize(sizes[0]) : 0;
+                MessageMax = sizes.size() == 2 ? ParseSize(sizes[1]) : 0;
+                if (MessageMin == 0 || MessageMin > MessageMax)
+                {
+                    fprintf(stderr, "--messages takes the smallest and largest message size, e.g. 200,16K\n");
+                    return false;
+                }
+            }
+            else if (arg == "--message-seed")
+                MessageSeed = strtoull(value, nullptr, 10);
+            else if (arg == "--dictionary")
+                Dictionary = value;
+            else if (arg == "--train-dictionary")
+                DictionaryTrainDir = value;
+            else if (arg == "--dictionary-size")
+                DictionarySize = ParseSize(value);
+            else if (arg == "--early-exit")
+                EarlyExit = atof(value);
+            else if (arg == "--parallel")
+                ParallelThreads = string(value) == "all" ? Platform::CoreCount() : (unsigned)atoi(value);
+            else if (arg == "--auto-budget")
+                AutoBudget = atof(value);
+            else if (arg == "--scrub-size")
+                ScrubSize = ParseSize(value);
+            else if (arg == "--huge-pages")
+            {
+                PageAllocator::HugePages pages[] = { PageAllocator::None, PageAllocator::Transparent, PageAllocator::Explicit };
+                auto match = find_if(begin(pages), end(pages), [value](PageAllocator::HugePages p) { return strcmp(PageAllocator::GetHugePagesName(p), value) == 0; });
+                if (match == end(pages))
+                {
+                    fprintf(stderr, "unknown --huge-pages mode %s\n", value);
+                    return false;
+                }
+                Pages.Pages = *match;
+            }
+            else if (arg == "--numa-node")
+                Pages.NumaNode = atoi(value);
+            else if (arg == "--madvise")
+            {
+                MappedFile::Advice advice[] = { MappedFile::Normal, MappedFile::Sequential, MappedFile::Random, MappedFile::WillNeed };
+                auto match = find_if(begin(advice), end(advice), [value](MappedFile::Advice a) { return strcmp(MappedFile::GetAdviceName(a), value) == 0; });
+                if (match == end(advice))
+                {
+                    fprintf(stderr, "unknown --madvise hint %s\n", value);
+                    return false;
+                }
+                Mapping.Access = *match;
+            }
+            else if (arg == "--chunk-size")
+                ChunkSize = ParseSize(value);
+            else if (arg == "--corpus")
+                CorpusDir = value;
+            else if (arg == "--artifacts")
+                ArtifactDir = value;
+            else if (arg == "--corpus-size")
+                Corpus.Size = ParseSize(value);
+            else if (arg == "--corpus-seed")
+                Corpus.Seed = strtoull(value, nullptr, 10);
+            else if (arg == "--corpus-variety")
+                Corpus.Variety = atof(value);
+            else if (arg == "--threads")
+                Threads = string(value) == "all" ? Platform::CoreCount() : (unsigned)atoi(value);
+            else if (arg == "--format")
+                Format = value;
+            else if (arg == "--output")
+                Output = value;
+            else if (arg == "--save")
+                Save = value;
+            else if (arg == "--compare")
+                Split(value, Compare);
+            else if (arg == "--threshold")
+                Threshold = atof(value);
+            else
+            {
+                fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+    }
+
+    if (Iterations < 1 || Warmup < 0)
+    {
+        fprintf(stderr, "--iterations must be at least 1 and --warmup can't be negative\n");
+        return false;
+    }
+
+    if (PinCore >= (int)Platform::CoreCount())
+    {
+        fprintf(stderr, "--pin core %d doesn't exist\n", PinCore);
+        return false;
+    }
+
+    if (Pages.NumaNode >= (int)Platform::NumaNodeCount())
+    {
+        fprintf(stderr, "--numa-node %d doesn't exist\n", Pages.NumaNode);
+        return false;
+    }
+
+    if (!Compare.empty() && Compare.size() != 2)
+    {
+        fprintf(stderr, "--compare takes two results files, e.g. --compare old.json,new.json\n");
+        return false;
+    }
+
+    if (Format != "csv" && Format != "json" && Format != "html")
+    {
+        fprintf(stderr, "unknown format %s\n", Format.c_str());
+        return false;
+    }
+
+    if (ChunkSize == 0 || ScrubSize == 0)
+    {
+        fprintf(stderr, "--chunk-size and --scrub-size must be positive\n");
+        return false;
+    }
+
+    if (DictionarySize == 0)
+    {
+        fprintf(stderr, "--dictionary-size must be positive\n");
+        return false;
+    }
+
+    if (Corpus.Size == 0 || Corpus.Variety < 0 || Corpus.Variety > 1)
+    {
+        fprintf(stderr, "--corpus-size must be positive and --corpus-variety between 0 and 1\n");
+        return false;
+    }
+
+    if (DataDirs.empty() && Files.empty() && CorpusDir.empty())
+        DataDirs.push_back("../TestData");
+
+    return true;
+}
+
+void BenchmarkOptions::PrintUsage(char const* program)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --codec <names>     comma separated codecs to run (default all)\n"
+        "  --pass <names>      comma separated passes to run (default all)\n"
+        "  --data <dir>        add every file in dir (default ../TestData)\n"
+        "  --file <path>       add a single file\n"
+        "  --iterations <n>    timed runs per pass, reported as min/median/p90/p99 and a 95%% interval (default 5)\n"
+        "  --warmup <n>        untimed runs before the timed ones (default 1)\n"
+        "  --pin <core>        pin the benchmark thread to a core, ideally one isolated with isolcpus\n"
+        "  --corpus <dir>      generate the synthetic datasets into dir and add them\n"
+        "  --corpus-size <n>   bytes per generated dataset, K and M suffixes work (default 1M)\n"
+        "  --corpus-seed <n>   seed for the generated datasets (default 1)\n"
+        "  --corpus-variety <f> 0 for repetitive to 1 for noisy generated data (default 0.5)\n"
+        "  --artifacts <dir>   keep compressed output in dir so decompression passes skip compressing\n"
+        "  --block-sizes <list> also compress every file as independent blocks, e.g. 1K,4K,64K,1M\n"
+        "  --messages <min,max> also replay every file as messages of min to max bytes and report per call latency\n"
+        "  --message-seed <n>  seed for the message sizes (default 1)\n"
+        "  --chunk-size <n>    input piece size for the streaming passes (default 64K)\n"
+        "  --stream-flush      flush the stream after every chunk\n"
+        "  --cold              also time every call on its own, warm and after scrubbing the caches\n"
+        "  --scrub-size <n>    bytes written between cold calls, at least the last level cache (default 32M)\n"
+        "  --mmap              map input files instead of reading them, for inputs bigger than memory\n"
+        "  --madvise <hint>    access hint for mapped files: normal, sequential, random or willneed (default sequential)\n"
+        "  --prefault          touch every page of a mapped file when it's first used, timed separately\n"
+        "  --huge-pages <mode> back codec buffers and zlib/lzo work memory with none, transparent or explicit huge pages\n"
+        "  --numa-node <n>     bind codec buffers and work memory to one NUMA node\n"
+        "  --threads <n|all>   run 1..n pinned copies of each codec at once and report scaling\n"
+        "  --sweep             add every codec at each of its levels and mark the ratio/speed frontier\n"
+        "  --lzo               add every LZO compressor with each of its safe, asm and optimized decompressors\n"
+        "  --early-exit <pct>  also run every codec behind an estimator that stores blocks it predicts save less than pct%%\n"
+        "  --auto-budget <ns>  compression time per byte the auto codec may spend on a block (default 5)\n"
+        "  --parallel <n|all>  add zlib and gzip codecs that compress one stream on n cores, pigz style\n"
+        "  --dictionary <path> add the zlib, lz4 and LZO1X-999 preset dictionary variants using this dictionary\n"
+        "  --train-dictionary <dir> same, with a dictionary trained on a sample of the files in dir\n"
+        "  --dictionary-size <n> bytes of dictionary to train (default 32K)\n"
+        "  --format <csv|json|html> output format, html plots the frontier (default csv)\n"
+        "  --output <path>     write results to path instead of stdout\n"
+        "  --save <path>       also save the raw results and build/host details as json\n"
+        "  --compare <a,b>     compare two saved runs instead of running, exits with 3 on regressions\n"
+        "  --threshold <f>     smallest relative speed change --compare reports (default 0.02)\n"
+        "  --perf              record hardware counters around every pass (linux only)\n"
+        "  --list              list codecs and passes, then exit\n"
+        "  --chart             run through CodeCompare and open the ChartJS page\n",
+        program);
+}
+
+bool BenchmarkOptions::IsSelected(vector<string> const& filter, char const* name)
+{
+    if (filter.empty())
+        return true;
+
+    for (string const& selected : filter)
+    {
+        if (selected == name)
+            return true;
+    }
+    return false;
+}
+
+Benchmark::Benchmark(BenchmarkOptions const& options)
+    : Options(options)
+    , Dictionary(options.Compare.empty() ? LoadDictionary(options) : nullptr)
+{
+}
+
+vector<unique_ptr<FileParameter const>> Benchmark::LoadFiles(BenchmarkOptions const& options)
+{
+    vector<unique_ptr<FileParameter const>> files;
+
+    vector<string> generated;
+    if (!options.CorpusDir.empty())
+        generated = CorpusGenerator(options.Corpus).Generate(options.CorpusDir);
+
+    auto addFile = [&files, &options](char const* filename, size_t size)
+    {
+        if (options.Mmap)
+            files.push_back(unique_ptr<FileParameter const>(new FileParameter(filename, size, options.Mapping)));
+        else
+            files.push_back(unique_ptr<FileParameter const>(new FileParameter(filename, size)));
+    };
+
+    for (string const& dir : options.DataDirs)
+        File::FindFile(dir.c_str(), "*.*", addFile);
+
+    vector<string> singleFiles = options.Files;
+
+    // already picked up above if the corpus went into one of the data directories
+    if (find(options.DataDirs.begin(), options.DataDirs.end(), options.CorpusDir) == options.DataDirs.end())
+        singleFiles.insert(singleFiles.end(), generated.begin(), generated.end());
+
+    for (string const& filename : singleFiles)
+    {
+        size_t size = 0;
+        if (!MappedFile::GetFileSize(filename.c_str(), size))
+        {
+            fprintf(stderr, "warning: couldn't open %s\n", filename.c_str());
+            continue;
+        }
+        addFile(filename.c_str(), size);
+    }
+
+    if (options.BlockSizes.empty() && options.MessageMax == 0)
+        return files;
+
+    // each whole file is followed by its block splits so results read as a curve
+    vector<unique_ptr<FileParameter const>> splitFiles;
+    for (auto& file : files)
+    {
+        FileParameter const& wholeFile = *file;
+        splitFiles.push_back(move(file));
+
+        for (size_t blockSize : options.BlockSizes)
+            splitFiles.push_back(unique_ptr<FileParameter const>(new FileParameter(wholeFile, blockSize)));
+
+        if (options.MessageMax)
+            splitFiles.push_back(unique_ptr<FileParameter const>(new FileParameter(wholeFile, options.MessageMin, options.MessageMax, options.MessageSeed)));
+    }
+    return splitFiles;
+}
+
+vector<unique_ptr<CompressionTest>> Benchmark::CreateTests(BenchmarkOptions const& options, shared_ptr<vector<char> const> const& dictionary)
+{
+    vector<unique_ptr<CompressionTest>> tests = CreateCodecs(options, dictionary);
+
+    // every codec again behind the estimator, "x-early" is reported against "x"
+    if (options.EarlyExit > 0)
+    {
+        for (auto& test : CreateCodecs(options, dictionary))
+        {
+            test->SetEarlyExit(options.EarlyExit / 100);
+            tests.push_back(move(test));
+        }
+    }
+
+    if (!options.ArtifactDir.empty())
+    {
+        shared_ptr<ArtifactCache const> artifacts = make_shared<ArtifactCache>(options.ArtifactDir);
+        for (auto& test : tests)
+            test->SetArtifactCache(artifacts);
+    }
+
+    return tests;
+}
+
+vector<unique_ptr<CompressionTest>> Benchmark::CreateCodecs(BenchmarkOptions const& options, shared_ptr<vector<char> const> const& dictionary)
+{
+    vector<unique_ptr<CompressionTest>> tests;
+
+    for (auto& test : CreateCompressionTests())
+    {
+        if (BenchmarkOptions::IsSelected(options.Codecs, test->GetCodecName()))
+        {
+            test->SetStreaming(options.ChunkSize, options.StreamFlush);
+            tests.push_back(move(test));
+        }
+    }
+
+    // the adaptive codec is reported after the fixed ones it picks from
+    if (BenchmarkOptions::IsSelected(options.Codecs, "auto"))
+        tests.push_back(unique_ptr<CompressionTest>(new AutoTest(options.AutoBudget)));
+
+    if (options.ParallelThreads)
+    {
+        for (bool gzip : { false, true })
+        {
+            unique_ptr<CompressionTest> test(new ZLibParallelTest(options.ParallelThreads, gzip));
+            if (BenchmarkOptions::IsSelected(options.Codecs, test->GetCodecName()))
+                tests.push_back(move(test));
+        }
+    }
+
+    vector<unique_ptr<CompressionTest>> extra;
+    if (options.Sweep)
+        extra = CreateLevelSweepTests();
+    if (options.Lzo)
+    {
+        for (auto& test : CreateLZOTests(true))
+            extra.push_back(move(test));
+    }
+    if (dictionary)
+    {
+        for (auto& test : CreateDictionaryTests(dictionary))
+            extra.push_back(move(test));
+    }
+
+    // the sweep, the LZO matrix and the dictionary baselines share names with each other
+    // and the default codecs
+    for (auto& test : extra)
+    {
+        auto sameName = [&test](unique_ptr<CompressionTest> const& other) { return strcmp(other->GetCodecName(), test->GetCodecName()) == 0; };
+        if (BenchmarkOptions::IsSelected(options.Codecs, test->GetCodecName()) && none_of(tests.begin(), tests.end(), sameName))
+            tests.push_back(move(test));
+    }
+
+    return tests;
+}
+
+shared_ptr<vector<char> const> Benchmark::LoadDictionary(BenchmarkOptions const& options)
+{
+    shared_ptr<vector<char>> dictionary = make_shared<vector<char>>();
+
+    if (!options.Dictionary.empty())
+    {
+        if (!DictionaryTrainer::Load(options.Dictionary, *dictionary))
+        {
+            fprintf(stderr, "warning: couldn't load dictionary %s\n", options.Dictionary.c_str());
+            return nullptr;
+        }
+    }
+    else if (!options.DictionaryTrainDir.empty())
+    {
+        vector<string> sample;
+        File::FindFile(options.DictionaryTrainDir.c_str(), "*.*", [&sample](char const* filename, size_t) { sample.push_back(filename); });
+        sort(sample.begin(), sample.end());
+
+        *dictionary = DictionaryTrainer::Train(sample, options.DictionarySize);
+        if (dictionary->empty())
+        {
+            fprintf(stderr, "warning: nothing to train a dictionary on in %s\n", options.DictionaryTrainDir.c_str());
+            return nullptr;
+        }
+    }
+    else
+        return nullptr;
+
+    return dictionary;
+}
+
+int Benchmark::Run()
+{
+    if (!Options.Compare.empty())
+        return Compare();
+
+    Instances.resize(max(Options.Threads, 1u));
+    for (auto& instance : Instances)
+        instance = CreateTests(Options, Dictionary);
+
+    vector<unique_ptr<CompressionTest>> const& tests = Instances[0];
+
+    if (Options.List)
+    {
+        for (auto const& test : tests)
+        {
+            printf("%s", test->GetCodecName());
+            for (auto const& pass : test->GetPasses())
+                printf(" %s", pass.Name.c_str());
+            printf("\n");
+        }
+        return 0;
+    }
+
+    vector<unique_ptr<FileParameter const>> files = LoadFiles(Options);
+
+    if (Options.PinCore >= 0)
+    {
+        if (!Platform::PinThread(Options.PinCore))
+            fprintf(stderr, "warning: couldn't pin to core %d\n", Options.PinCore);
+        else if (!Platform::IsIsolatedCore(Options.PinCore))
+            fprintf(stderr, "warning: core %d isn't isolated, other tasks can be scheduled on it\n", Options.PinCore);
+    }
+
+    string governor = Platform::ScalingGovernor(max(Options.PinCore, 0));
+    if (!governor.empty() && governor != "performance")
+        fprintf(stderr, "warning: cpu frequency scaling is active (%s governor), timings will drift\n", governor.c_str());
+
+    if (Options.Perf && !PerfCounters().IsAvailable())
+        fprintf(stderr, "warning: hardware counters aren't available, check perf_event_paranoid\n");
+
+    if (tests.empty() || files.empty())
+    {
+        fprintf(stderr, "nothing to run: %zu codecs, %zu files\n", tests.size(), files.size());
+        return 2;
+    }
+
+    vector<BenchmarkResult> results;
+
+    for (size_t testIndex = 0; testIndex < tests.size(); ++testIndex)
+    {
+        CompressionTest& test = *tests[testIndex];
+        vector<CompressionTest::PassFunctions> const& passes = test.GetPasses();
+
+        for (size_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+        {
+            if (!BenchmarkOptions::IsSelected(Options.Passes, passes[passIndex].Name.c_str()))
+                continue;
+
+            // first result row of each whole file, block split rows are compared against it
+            map<string, size_t> wholeFileResults;
+
+            for (auto const& file : files)
+            {
+                fprintf(stderr, "%s %s %s\n", test.GetCodecName(), passes[passIndex].Name.c_str(), file->GetName());
+
+                size_t first = results.size();
+
+                if (Options.Threads)
+                {
+                    vector<BenchmarkResult> scaling = RunScaling(testIndex, passIndex, *file);
+                    results.insert(results.end(), scaling.begin(), scaling.end());
+                }
+                else
+                {
+                    results.push_back(RunPass(test, passes[passIndex], *file));
+                }
+
+                if (file->IsWholeFile())
+                    wholeFileResults[file->GetSourceName()] = first;
+                else if (wholeFileResults.count(file->GetSourceName()))
+                    AddCallOverhead(results, first, wholeFileResults[file->GetSourceName()]);
+            }
+        }
+    }
+
+    AddStreamingOverhead(results);
+    AddDictionaryGain(results);
+    AddEarlyExitGain(results);
+    AddParallelGain(results);
+    AddPareto(results);
+
+    if (size_t fallbacks = PageAllocator::GetFallbacks())
+        fprintf(stderr, "warning: %zu buffer mappings didn't get the huge pages or numa node asked for\n", fallbacks);
+
+    if (Options.Output.empty())
+    {
+        WriteResults(results, cout);
+    }
+    else
+    {
+        ofstream out(Options.Output);
+        if (!out)
+        {
+            fprintf(stderr, "couldn't open %s\n", Options.Output.c_str());
+            return 1;
+        }
+
+        WriteResults(results, out);
+    }
+
+    if (!Options.Save.empty())
+    {
+        ofstream out(Options.Save);
+        if (!out)
+        {
+            fprintf(stderr, "couldn't open %s\n", Options.Save.c_str());
+            return 1;
+        }
+
+        WriteJson(results, out);
+    }
+
+    return 0;
+}
+
+BenchmarkResult Benchmark::CreateResult(CompressionTest const& test, CompressionTest::PassFunctions const& pass, FileParameter const& file, size_t resultSize) const
+{
+    double inputSize = (double)file.Max();
+
+    BenchmarkResult result;
+    result.Codec = test.GetCodecName();
+    result.File = file.GetName();
+    result.Pass = pass.Name;
+    result.AddMetric("input_bytes", inputSize);
+    result.AddMetric("result_bytes", (double)resultSize);
+    result.AddMetric("ratio", inputSize > 0 ? resultSize / inputSize : 0);
+    result.AddMetric("iterations", Options.Iterations);
+    result.AddMetric("blocks", (double)file.Blocks().size());
+    result.AddMetric("block_bytes", (double)file.GetBlockSize());
+    return result;
+}
+
+void Benchmark::AddTimings(BenchmarkResult& result, FileParameter const& file, vector<double> samples, unsigned threads) const
+{
+    double inputSize = (double)file.Max();
+    size_t count = samples.size();
+    sort(samples.begin(), samples.end());
+
+    double mean = 0;
+    for (double seconds : samples)
+        mean += seconds;
+    mean /= count;
+
+    double variance = 0;
+    for (double seconds : samples)
+        variance += (seconds - mean) * (seconds - mean);
+    double deviation = count > 1 ? sqrt(variance / (count - 1)) : 0;
+
+    double best = samples[0];
+    double median = Percentile(samples, 0.5);
+
+    result.Samples = samples;
+    result.AddMetric("best_seconds", best);
+    result.AddMetric("mean_seconds", mean);
+    result.AddMetric("median_seconds", median);
+    result.AddMetric("p90_seconds", Percentile(samples, 0.9));
+    result.AddMetric("p99_seconds", Percentile(samples, 0.99));
+    result.AddMetric("stddev_seconds", deviation);
+    result.AddMetric("ci95_seconds", count > 1 ? StudentT95(count - 1) * deviation / sqrt((double)count) : 0);
+    result.AddMetric("mb_per_s", best > 0 ? threads * inputSize / best / 1e6 : 0);
+    result.AddMetric("median_mb_per_s", median > 0 ? threads * inputSize / median / 1e6 : 0);
+    result.AddMetric("us_per_call", best / file.Blocks().size() * 1e6);
+}
+
+void Benchmark::AddCallOverhead(vector<BenchmarkResult>& results, size_t first, size_t wholeFile) const
+{
+    // extra time per call compared to compressing the whole file in one go
+    for (size_t i = first; i < results.size(); ++i)
+    {
+        double blocks = results[i].GetMetric("blocks");
+        double extra = results[i].GetMetric("best_seconds") - results[wholeFile + i - first].GetMetric("best_seconds");
+        results[i].AddMetric("overhead_us_per_call", extra / blocks * 1e6);
+    }
+}
+
+void Benchmark::AddStreamingOverhead(vector<BenchmarkResult>& results) const
+{
+    string const prefix = "streaming ";
+    for (auto& result : results)
+    {
+        if (result.Pass.compare(0, prefix.size(), prefix) != 0)
+            continue;
+
+        string pass = result.Pass.substr(prefix.size());
+        for (auto const& oneShot : results)
+        {
+            if (oneShot.Pass != pass || oneShot.Codec != result.Codec || oneShot.File != result.File
+                || oneShot.GetMetric("threads") != result.GetMetric("threads"))
+                continue;
+
+            // above 1 means streaming is faster / compresses worse
+            double speed = oneShot.GetMetric("mb_per_s");
+            double ratio = oneShot.GetMetric("ratio");
+            result.AddMetric("vs_oneshot_mb_per_s", speed > 0 ? result.GetMetric("mb_per_s") / speed : 0);
+            result.AddMetric("vs_oneshot_ratio", ratio > 0 ? result.GetMetric("ratio") / ratio : 0);
+            break;
+        }
+    }
+}
+
+void Benchmark::AddDictionaryGain(vector<BenchmarkResult>& results) const
+{
+    string const suffix = "-dict";
+    for (auto& result : results)
+    {
+        if (result.Codec.size() <= suffix.size() || result.Codec.compare(result.Codec.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        string codec = result.Codec.substr(0, result.Codec.size() - suffix.size());
+        for (auto const& plain : results)
+        {
+            if (plain.Codec != codec || plain.Pass != result.Pass || plain.File != result.File
+                || plain.GetMetric("threads") != result.GetMetric("threads"))
+                continue;
+
+            // below 1 for the ratio means the dictionary helped
+            double speed = plain.GetMetric("mb_per_s");
+            double ratio = plain.GetMetric("ratio");
+            result.AddMetric("vs_nodict_mb_per_s", speed > 0 ? result.GetMetric("mb_per_s") / speed : 0);
+            result.AddMetric("vs_nodict_ratio", ratio > 0 ? result.GetMetric("ratio") / ratio : 0);
+            break;
+        }
+    }
+}
+
+void Benchmark::AddEarlyExitGain(vector<BenchmarkResult>& results) const
+{
+    string const suffix = "-early";
+    for (auto& result : results)
+    {
+        if (result.Codec.size() <= suffix.size() || result.Codec.compare(result.Codec.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        string codec = result.Codec.substr(0, result.Codec.size() - suffix.size());
+        for (auto const& plain : results)
+        {
+            if (plain.Codec != codec || plain.Pass != result.Pass || plain.File != result.File
+                || plain.GetMetric("threads") != result.GetMetric("threads"))
+                continue;
+
+            // negative savings are the estimator's cost on data it let through
+            double seconds = plain.GetMetric("best_seconds");
+            result.AddMetric("early_exit_seconds_saved", seconds - result.GetMetric("best_seconds"));
+            result.AddMetric("early_exit_time_saved", seconds > 0 ? 1 - result.GetMetric("best_seconds") / seconds : 0);
+            result.AddMetric("early_exit_ratio_lost", result.GetMetric("ratio") - plain.GetMetric("ratio"));
+            break;
+        }
+    }
+}
+
+void Benchmark::AddParallelGain(vector<BenchmarkResult>& results) const
+{
+    string const suffix = "-parallel";
+    for (auto& result : results)
+    {
+        if (result.Codec.size() <= suffix.size() || result.Codec.compare(result.Codec.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+
+        // both formats carry the same deflate stream, so both are held against plain zlib
+        for (auto const& plain : results)
+        {
+            if (plain.Codec != "zlib" || plain.Pass != result.Pass || plain.File != result.File
+                || plain.GetMetric("threads") != result.GetMetric("threads"))
+                continue;
+
+            double speed = plain.GetMetric("mb_per_s");
+            double ratio = plain.GetMetric("ratio");
+            result.AddMetric("vs_zlib_mb_per_s", speed > 0 ? result.GetMetric("mb_per_s") / speed : 0);
+            result.AddMetric("vs_zlib_ratio", ratio > 0 ? result.GetMetric("ratio") / ratio : 0);
+            break;
+        }
+    }
+}
+
+void Benchmark::AddPareto(vector<BenchmarkResult>& results) const
+{
+    map<pair<string, string>, double> ratios = CompressedRatios(results);
+
+    for (auto& result : results)
+    {
+        auto ratio = ratios.find(make_pair(result.Codec, result.File));
+        if (!IsOneShot(result) || ratio == ratios.end())
+            continue;
+
+        double speed = result.GetMetric("mb_per_s");
+
+        bool dominated = false;
+        for (auto const& other : results)
+        {
+            auto otherRatio = ratios.find(make_pair(other.Codec, other.File));
+            if (&other == &result || other.Pass != result.Pass || other.File != result.File || !IsOneShot(other) || otherRatio == ratios.end())
+                continue;
+
+            double otherSpeed = other.GetMetric("mb_per_s");
+            if (otherRatio->second <= ratio->second && otherSpeed >= speed && (otherRatio->second < ratio->second || otherSpeed > speed))
+            {
+                dominated = true;
+                break;
+            }
+        }
+
+        result.AddMetric("pareto", dominated ? 0 : 1);
+    }
+}
+
+void Benchmark::AddCounters(BenchmarkResult& result, FileParameter const& file, double const* totals) const
+{
+    // counters that couldn't be opened read negative and are left out
+    double means[PerfCounters::CounterCount];
+    for (int c = 0; c < PerfCounters::CounterCount; ++c)
+    {
+        means[c] = totals[c] / Options.Iterations;
+        if (means[c] >= 0)
+            result.AddMetric(PerfCounters::GetName((PerfCounters::Counter)c), means[c]);
+    }
+
+    double cycles = means[PerfCounters::Cycles];
+    double instructions = means[PerfCounters::Instructions];
+    if (cycles > 0 && instructions >= 0)
+        result.AddMetric("ipc", instructions / cycles);
+    if (cycles > 0 && file.Max() > 0)
+        result.AddMetric("cycles_per_byte", cycles / file.Max());
+}
+
+void Benchmark::AddInitCost(BenchmarkResult& result, CompressionTest const& test, bool compress) const
+{
+    // a context init is short so time a batch of them
+    int const count = 100;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        if (!test.InitContext(compress))
+            return;
+    }
+    double initSeconds = chrono::duration<double>(Clock::now() - start).count() / count;
+
+    result.AddMetric("init_us", initSeconds * 1e6);
+
+    // variants that don't reuse their context pay the init on every call
+    if (!test.GetReuseContext())
+        result.AddMetric("us_per_call_excl_init", result.GetMetric("us_per_call") - initSeconds * 1e6);
+}
+
+void Benchmark::AddCallLatency(BenchmarkResult& result, CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const
+{
+    // dirtying one byte per cache line pushes the input, output, codec tables and most of
+    // the code out of every level, like a server that ran other requests in between
+    vector<char> scrub(Options.ScrubSize);
+    auto evict = [&scrub]
+    {
+        for (size_t i = 0; i < scrub.size(); i += 64)
+            ++scrub[i];
+    };
+    evict();
+
+    double median[2];
+    for (int cold = 0; cold < 2; ++cold)
+    {
+        test.SetCallTiming(true, cold ? evict : function<void()>());
+
+        vector<double> calls;
+        for (int i = 0; i < Options.Iterations; ++i)
+        {
+            pass.Setup(&file);
+            pass.Run(&file);
+            calls.insert(calls.end(), test.GetCallSeconds().begin(), test.GetCallSeconds().end());
+            pass.Teardown(&file);
+        }
+        sort(calls.begin(), calls.end());
+
+        median[cold] = Percentile(calls, 0.5);
+        result.AddMetric(cold ? "cold_us_per_call_median" : "warm_us_per_call_median", median[cold] * 1e6);
+        result.AddMetric(cold ? "cold_us_per_call_p99" : "warm_us_per_call_p99", Percentile(calls, 0.99) * 1e6);
+    }
+    test.SetCallTiming(false, function<void()>());
+
+    result.AddMetric("cold_vs_warm", median[0] > 0 ? median[1] / median[0] : 0);
+}
+
+void Benchmark::AddLatencyHistogram(BenchmarkResult& result, CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const
+{
+    LatencyHistogram histogram;
+
+    test.SetCallTiming(true, function<void()>());
+    for (int i = 0; i < Options.Iterations; ++i)
+    {
+        pass.Setup(&file);
+        pass.Run(&file);
+        for (double seconds : test.GetCallSeconds())
+            histogram.Record((uint64_t)(seconds * 1e9 + 0.5));
+        pass.Teardown(&file);
+    }
+    test.SetCallTiming(false, function<void()>());
+
+    result.AddMetric("latency_calls", (double)histogram.GetCount());
+    result.AddMetric("latency_us_p50", histogram.GetPercentile(0.5) / 1e3);
+    result.AddMetric("latency_us_p99", histogram.GetPercentile(0.99) / 1e3);
+    result.AddMetric("latency_us_p999", histogram.GetPercentile(0.999) / 1e3);
+    result.AddMetric("latency_us_max", histogram.GetMax() / 1e3);
+}
+
+BenchmarkResult Benchmark::RunPass(CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const
+{
+    vector<double> samples;
+    size_t resultSize = 0;
+    MemoryTracker::Stats memory;
+    unsigned minMHz = 0;
+    unsigned maxMHz = 0;
+
+    unique_ptr<PerfCounters> counters(Options.Perf ? new PerfCounters() : nullptr);
+    double counterTotals[PerfCounters::CounterCount] = {};
+    size_t minorFaults = 0;
+    size_t majorFaults = 0;
+
+    // untimed runs first so caches, branch predictors and the clock speed settle
+    for (int i = 0; i < Options.Warmup; ++i)
+    {
+        pass.Setup(&file);
+        pass.Run(&file);
+        pass.Teardown(&file);
+    }
+
+    // setup and teardown run around every iteration, same as a CodeCompare pass, so
+    // buffers sized in setup are never reused after a pass shrinks them
+    for (int i = 0; i < Options.Iterations; ++i)
+    {
+        pass.Setup(&file);
+
+        MemoryTracker::Begin();
+        if (counters)
+            counters->Start();
+
+        size_t minorBefore = 0, majorBefore = 0;
+        Platform::PageFaults(minorBefore, majorBefore);
+
+        Clock::time_point start = Clock::now();
+        resultSize = pass.Run(&file);
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+        size_t minorAfter = 0, majorAfter = 0;
+        Platform::PageFaults(minorAfter, majorAfter);
+        minorFaults += minorAfter - minorBefore;
+        majorFaults += majorAfter - majorBefore;
+
+        if (counters)
+        {
+            counters->Stop();
+            for (int c = 0; c < PerfCounters::CounterCount; ++c)
+                counterTotals[c] += counters->Get((PerfCounters::Counter)c);
+        }
+        memory = MemoryTracker::End();
+
+        pass.Teardown(&file);
+
+        samples.push_back(seconds);
+
+        // only meaningful when pinned, otherwise the thread may have moved between cores
+        if (Options.PinCore >= 0)
+        {
+            unsigned mhz = Platform::CpuFrequencyMHz(Options.PinCore);
+            minMHz = i == 0 ? mhz : min(minMHz, mhz);
+            maxMHz = max(maxMHz, mhz);
+        }
+    }
+
+    BenchmarkResult result = CreateResult(test, pass, file, resultSize);
+    AddTimings(result, file, samples, 1);
+
+    if (maxMHz > 0)
+    {
+        result.AddMetric("cpu_mhz_min", minMHz);
+        result.AddMetric("cpu_mhz_max", maxMHz);
+    }
+
+    double calls = (double)file.Blocks().size();
+    size_t workMemory = test.GetWorkMemorySize(pass.Compress);
+    result.AddMetric("alloc_bytes_per_call", memory.AllocatedBytes / calls);
+    result.AddMetric("allocs_per_call", memory.Allocations / calls);
+    result.AddMetric("peak_heap_bytes", (double)memory.PeakBytes);
+    result.AddMetric("work_memory_bytes", (double)workMemory);
+    result.AddMetric("peak_memory_bytes", (double)(memory.PeakBytes + workMemory));
+
+    // faults taken inside the timed runs, mostly first touches of a mapping or of fresh buffers
+    result.AddMetric("minor_faults_per_iteration", (double)minorFaults / Options.Iterations);
+    result.AddMetric("major_faults_per_iteration", (double)majorFaults / Options.Iterations);
+    if (file.IsMapped())
+        result.AddMetric("prefault_seconds", file.GetPrefaultSeconds());
+
+    if (test.HasEarlyExit())
+        result.AddMetric("passthrough_share", test.GetPassthroughShare());
+
+    for (auto const& metric : test.GetPassMetrics(pass.Compress))
+        result.AddMetric(metric.first.c_str(), metric.second);
+
+    if (counters && counters->IsAvailable())
+        AddCounters(result, file, counterTotals);
+
+    AddInitCost(result, test, pass.Compress);
+
+    if (Options.Cold)
+        AddCallLatency(result, test, pass, file);
+
+    if (file.IsMessageStream())
+        AddLatencyHistogram(result, test, pass, file);
+
+    return result;
+}
+
+vector<BenchmarkResult> Benchmark::RunScaling(size_t testIndex, size_t passIndex, FileParameter const& file) const
+{
+    vector<BenchmarkResult> results;
+    double inputSize = (double)file.Max();
+    double singleThread = 0;
+    bool pinned = true;
+
+    for (unsigned threadCount = 1; threadCount <= Options.Threads; ++threadCount)
+    {
+        vector<unique_ptr<FileParameter const>> inputs;
+        for (unsigned t = 0; t < threadCount; ++t)
+            inputs.push_back(unique_ptr<FileParameter const>(new FileParameter(file)));
+
+        vector<Clock::time_point> starts(threadCount);
+        vector<Clock::time_point> ends(threadCount);
+        vector<char> pinnedThreads(threadCount);
+        ThreadBarrier barrier(threadCount);
+
+        vector<double> samples;
+        size_t resultSize = 0;
+
+        auto worker = [&](unsigned t)
+        {
+            pinnedThreads[t] = Platform::PinThread(t % Platform::CoreCount());
+
+            CompressionTest::PassFunctions const& pass = Instances[t][testIndex]->GetPasses()[passIndex];
+            FileParameter const* input = inputs[t].get();
+
+            // negative iterations are the untimed warm-up
+            for (int i = -Options.Warmup; i < Options.Iterations; ++i)
+            {
+                pass.Setup(input);
+                barrier.Wait();
+
+                starts[t] = Clock::now();
+                size_t size = pass.Run(input);
+                ends[t] = Clock::now();
+
+                barrier.Wait();
+
+                // every thread has written its times by now and none can overwrite them
+                // until thread 0 reaches the next barrier
+                if (t == 0 && i >= 0)
+                {
+                    resultSize = size;
+                    samples.push_back(chrono::duration<double>(*max_element(ends.begin(), ends.end()) - *min_element(starts.begin(), starts.end())).count());
+                }
+
+                pass.Teardown(input);
+            }
+        };
+
+        vector<thread> threads;
+        for (unsigned t = 0; t < threadCount; ++t)
+            threads.push_back(thread(worker, t));
+        for (auto& t : threads)
+            t.join();
+
+        for (char threadPinned : pinnedThreads)
+            pinned = pinned && threadPinned;
+
+        double best = *min_element(samples.begin(), samples.end());
+        double aggregate = best > 0 ? threadCount * inputSize / best / 1e6 : 0;
+        if (threadCount == 1)
+            singleThread = aggregate;
+
+        CompressionTest const& test = *Instances[0][testIndex];
+        BenchmarkResult result = CreateResult(test, test.GetPasses()[passIndex], file, resultSize);
+        result.AddMetric("threads", threadCount);
+        AddTimings(result, file, samples, threadCount);
+        result.AddMetric("per_thread_mb_per_s", aggregate / threadCount);
+        result.AddMetric("efficiency", singleThread > 0 ? aggregate / (threadCount * singleThread) : 0);
+        results.push_back(result);
+    }
+
+    if (!pinned)
+        fprintf(stderr, "warning: couldn't pin every thread to its own core\n");
+
+    return results;
+}
+
+vector<pair<string, string>> Benchmark::CollectMetadata() const
+{
+    vector<pair<string, string>> metadata;
+
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    metadata.push_back(make_pair("timestamp", timestamp));
+
+#if defined(ZIPCOMPARE_REVISION)
+    metadata.push_back(make_pair("revision", ZIPCOMPARE_REVISION));
+#endif
+
+    metadata.push_back(make_pair("host", Platform::HostName()));
+#if defined(_WIN32)
+    metadata.push_back(make_pair("os", "windows"));
+#elif defined(__linux__)
+    metadata.push_back(make_pair("os", "linux"));
+#elif defined(__APPLE__)
+    metadata.push_back(make_pair("os", "macos"));
+#else
+    metadata.push_back(make_pair("os", "unknown"));
+#endif
+    metadata.push_back(make_pair("cores", to_string(Platform::CoreCount())));
+    metadata.push_back(make_pair("governor", Platform::ScalingGovernor(max(Options.PinCore, 0))));
+    metadata.push_back(make_pair("huge_pages", PageAllocator::GetHugePagesName(Options.Pages.Pages)));
+    metadata.push_back(make_pair("numa_node", to_string(Options.Pages.NumaNode)));
+
+#if defined(_MSC_VER)
+    metadata.push_back(make_pair("compiler", "msvc " + to_string(_MSC_FULL_VER)));
+#elif defined(__clang__)
+    metadata.push_back(make_pair("compiler", "clang " __clang_version__));
+#elif defined(__GNUC__)
+    metadata.push_back(make_pair("compiler", "gcc " __VERSION__));
+#else
+    metadata.push_back(make_pair("compiler", "unknown"));
+#endif
+#if defined(NDEBUG)
+    metadata.push_back(make_pair("build", "release"));
+#else
+    metadata.push_back(make_pair("build", "debug"));
+#endif
+
+    metadata.push_back(make_pair("zlib", ZLIB_VERSION));
+    metadata.push_back(make_pair("lz4", LZ4_VERSION_STRING));
+    metadata.push_back(make_pair("lzo", LZO_VERSION_STRING));
+    metadata.push_back(make_pair("command_line", Options.CommandLine));
+    return metadata;
+}
+
+int Benchmark::Compare() const
+{
+    ResultsFile::Run base;
+    ResultsFile::Run current;
+    if (!ResultsFile::Read(Options.Compare[0].c_str(), base) || !ResultsFile::Read(Options.Compare[1].c_str(), current))
+        return 1;
+
+    for (char const* name : { "host", "compiler", "build", "zlib", "lz4", "lzo", "revision", "huge_pages", "numa_node" })
+    {
+        string before = base.GetMetadata(name);
+        string after = current.GetMetadata(name);
+        if (before != after)
+            fprintf(stderr, "%s: %s -> %s\n", name, before.c_str(), after.c_str());
+    }
+
+    ostringstream out;
+    out << "codec,file,pass,threads,base_mb_per_s,new_mb_per_s,speed_change,significant,base_ratio,new_ratio,ratio_change,verdict\n";
+
+    int regressions = 0;
+    int improvements = 0;
+    for (auto const& result : current.Results)
+    {
+        auto match = find_if(base.Results.begin(), base.Results.end(), [&result](BenchmarkResult const& other)
+        {
+            return other.Codec == result.Codec && other.File == result.File && other.Pass == result.Pass
+                && other.GetMetric("threads") == result.GetMetric("threads");
+        });
+        if (match == base.Results.end())
+            continue;
+
+        // speed on the median iteration, significance from Welch's t-test on the samples
+        double baseSpeed = match->GetMetric("median_mb_per_s");
+        double newSpeed = result.GetMetric("median_mb_per_s");
+        double speedChange = baseSpeed > 0 ? newSpeed / baseSpeed - 1 : 0;
+        bool significant = IsSignificant(match->Samples, result.Samples);
+
+        // output only depends on the build and the processor, zlib hashes with crc32c where
+        // there's SSE4.2, so a size change is real unless the host changed. auto picks its
+        // codecs by timing them and gets a different mix every run, only its speed is judged.
+        double baseRatio = match->GetMetric("ratio");
+        double newRatio = result.GetMetric("ratio");
+        double ratioChange = baseRatio > 0 ? newRatio / baseRatio - 1 : 0;
+        bool timed = result.Codec == "auto" || result.Codec == "auto-early";
+        double sizeChange = timed ? 0 : ratioChange;
+
+        char const* verdict = "same";
+        if ((significant && speedChange < -Options.Threshold) || sizeChange > 1e-9)
+            verdict = "regression";
+        else if ((significant && speedChange > Options.Threshold) || sizeChange < -1e-9)
+            verdict = "improvement";
+
+        regressions += strcmp(verdict, "regression") == 0;
+        improvements += strcmp(verdict, "improvement") == 0;
+
+        out << EscapeCsv(result.Codec) << ',' << EscapeCsv(result.File) << ',' << EscapeCsv(result.Pass)
+            << ',' << FormatValue(result.GetMetric("threads"))
+            << ',' << FormatValue(baseSpeed) << ',' << FormatValue(newSpeed) << ',' << FormatValue(speedChange)
+            << ',' << (significant ? 1 : 0)
+            << ',' << FormatValue(baseRatio) << ',' << FormatValue(newRatio) << ',' << FormatValue(ratioChange)
+            << ',' << verdict << '\n';
+    }
+
+    if (Options.Output.empty())
+    {
+        cout << out.str();
+    }
+    else
+    {
+        ofstream file(Options.Output);
+        if (!file)
+        {
+            fprintf(stderr, "couldn't open %s\n", Options.Output.c_str());
+            return 1;
+        }
+        file << out.str();
+    }
+
+    fprintf(stderr, "%d regressions, %d improvements\n", regressions, improvements);
+    return regressions ? 3 : 0;
+}
+
+void Benchmark::WriteResults(vector<BenchmarkResult> const& results, ostream& out) const
+{
+    if (Options.Format == "json")
+        WriteJson(results, out);
+    else if (Options.Format == "html")
+        WriteHtml(results, out);
+    else
+        WriteCsv(results, out);
+}
+
+void Benchmark::WriteCsv(vector<BenchmarkResult> const& results, ostream& out) const
+{
+    // union of every metric name, in first seen order
+    vector<string> columns;
+    for (auto const& result : results)
+    {
+        for (auto const& metric : result.Metrics)
+        {
+            if (find(columns.begin(), columns.end(), metric.first) == columns.end())
+                columns.push_back(metric.first);
+        }
+    }
+
+    out << "codec,file,pass";
+    for (auto const& column : columns)
+        out << ',' << column;
+    out << '\n';
+
+    for (auto const& result : results)
+    {
+        out << EscapeCsv(result.Codec) << ',' << EscapeCsv(result.File) << ',' << EscapeCsv(result.Pass);
+        for (auto const& column : columns)
+        {
+            out << ',';
+            for (auto const& metric : result.Metrics)
+            {
+                if (metric.first == column)
+                {
+                    out << FormatValue(metric.second);
+                    break;
+                }
+            }
+        }
+        out << '\n';
+    }
+}
+
+void Benchmark::WriteJson(vector<BenchmarkResult> const& results, ostream& out) const
+{
+    out << "{\n  \"metadata\": {";
+    vector<pair<string, string>> metadata = CollectMetadata();
+    for (size_t i = 0; i < metadata.size(); ++i)
+        out << (i ? ",\n" : "\n") << "    \"" << metadata[i].first << "\": \"" << EscapeJson(metadata[i].second) << '"';
+    out << "\n  },\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        BenchmarkResult const& result = results[i];
+
+        out << (i ? ",\n" : "\n") << "    {\"codec\": \"" << EscapeJson(result.Codec)
+            << "\", \"file\": \"" << EscapeJson(result.File)
+            << "\", \"pass\": \"" << EscapeJson(result.Pass) << '"';
+
+        for (auto const& metric : result.Metrics)
+            out << ", \"" << metric.first << "\": " << FormatValue(metric.second);
+
+        if (!result.Samples.empty())
+        {
+            out << ", \"samples\": [";
+            for (size_t s = 0; s < result.Samples.size(); ++s)
+                out << (s ? ", " : "") << FormatValue(result.Samples[s]);
+            out << ']';
+        }
+
+        out << '}';
+    }
+    out << "\n  ]\n}\n";
+}
+
+void Benchmark::WriteHtml(vector<BenchmarkResult> const& results, ostream& out) const
+{
+    map<pair<string, string>, double> ratios = CompressedRatios(results);
+
+    vector<string> files;
+    for (auto const& result : results)
+    {
+        if (find(files.begin(), files.end(), result.File) == files.end())
+            files.push_back(result.File);
+    }
+
+    out << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+        "<script src=\"https://cdnjs.cloudflare.com/ajax/libs/Chart.js/2.5.0/Chart.min.js\"></script>\n"
+        "<script>\n"
+        "// points: [{codec, ratio, speed, pareto}], the frontier is drawn as a line through the pareto points\n"
+        "function CreateParetoChart(id, title, points) {\n"
+        "    var all = points.map(function (p) { return { x: p.speed, y: p.ratio, codec: p.codec }; });\n"
+        "    var frontier = all.filter(function (p, i) { return points[i].pareto; }).sort(function (a, b) { return a.x - b.x; });\n"
+        "    new Chart(document.getElementById(id), {\n"
+        "        type: 'scatter',\n"
+        "        data: { datasets: [\n"
+        "            { label: 'pareto frontier', data: frontier, showLine: true, fill: false, borderColor: 'rgba(220,60,60,1)', backgroundColor: 'rgba(220,60,60,1)', lineTension: 0 },\n"
+        "            { label: 'all settings', data: all, showLine: false, borderColor: 'rgba(75,120,192,1)', backgroundColor: 'rgba(75,120,192,0.4)' }] },\n"
+        "        options: {\n"
+        "            title: { display: true, text: title },\n"
+        "            legend: { position: 'bottom' },\n"
+        "            tooltips: { callbacks: { label: function (item, data) {\n"
+        "                var p = data.datasets[item.datasetIndex].data[item.index];\n"
+        "                return p.codec + ': ' + p.y.toFixed(4) + ' @ ' + p.x.toFixed(1) + ' MB/s'; } } },\n"
+        "            scales: {\n"
+        "                xAxes: [{ type: 'logarithmic', scaleLabel: { display: true, labelString: 'MB/s' } }],\n"
+        "                yAxes: [{ scaleLabel: { display: true, labelString: 'compressed size / input size' } }] }\n"
+        "        }\n"
+        "    });\n"
+        "}\n"
+        "// same as CreateLatencyChart in docs/results.html.js, codecs: [{name, latencies: [p50, p99, p99.9, max], color}]\n"
+        "function CreateLatencyChart(chartConfig) {\n"
+        "    new Chart(document.getElementById(chartConfig.id), {\n"
+        "        type: 'bar',\n"
+        "        data: { labels: ['p50', 'p99', 'p99.9', 'max'], datasets: chartConfig.codecs.map(function (e) {\n"
+        "            return { label: e.name, backgroundColor: e.color, borderColor: e.color, borderWidth: 1, data: e.latencies }; }) },\n"
+        "        options: {\n"
+        "            title: { display: true, text: chartConfig.test },\n"
+        "            legend: { position: 'bottom' },\n"
+        "            scales: { yAxes: [{ type: 'logarithmic', scaleLabel: { display: true, labelString: 'us per call' } }] }\n"
+        "        }\n"
+        "    });\n"
+        "}\n"
+        "</script>\n</head>\n<body>\n";
+
+    int chart = 0;
+    for (string const& file : files)
+    {
+        for (char const* pass : { "compression", "decompression" })
+        {
+            string points;
+            for (auto const& result : results)
+            {
+                auto ratio = ratios.find(make_pair(result.Codec, result.File));
+                if (result.File != file || result.Pass != pass || !IsOneShot(result) || ratio == ratios.end())
+                    continue;
+
+                points += points.empty() ? "\n" : ",\n";
+                points += "  {codec: \"" + EscapeJson(result.Codec) + "\", ratio: " + FormatValue(ratio->second)
+                    + ", speed: " + FormatValue(result.GetMetric("mb_per_s"))
+                    + ", pareto: " + (result.GetMetric("pareto") ? "true" : "false") + "}";
+            }
+
+            if (points.empty())
+                continue;
+
+            string id = "chart" + to_string(chart++);
+            out << "<canvas id=\"" << id << "\" width=\"800\" height=\"400\"></canvas>\n"
+                << "<script>CreateParetoChart(\"" << id << "\", \"" << EscapeJson(file) << " " << pass << "\", [" << points << "]);</script>\n";
+        }
+
+        // message streams also get their per call latency tails
+        for (char const* pass : { "compression", "decompression" })
+        {
+            char const* colors[] = { "rgba(46,134,3,1)", "rgba(94,20,130,1)", "rgba(7,114,140,1)", "rgba(182,9,88,1)", "rgba(69,224,133,1)", "rgba(144,84,46,1)" };
+
+            string codecs;
+            size_t count = 0;
+            for (auto const& result : results)
+            {
+                if (result.File != file || result.Pass != pass || result.GetMetric("latency_calls") == 0)
+                    continue;
+
+                codecs += codecs.empty() ? "\n" : ",\n";
+                codecs += "  {name: \"" + EscapeJson(result.Codec) + "\", latencies: [" + FormatValue(result.GetMetric("latency_us_p50"))
+                    + ", " + FormatValue(result.GetMetric("latency_us_p99")) + ", " + FormatValue(result.GetMetric("latency_us_p999"))
+                    + ", " + FormatValue(result.GetMetric("latency_us_max")) + "], color: \"" + colors[count++ % 6] + "\"}";
+            }
+
+            if (codecs.empty())
+                continue;
+
+            string id = "chart" + to_string(chart++);
+            out << "<canvas id=\"" << id << "\" width=\"800\" height=\"400\"></canvas>\n"
+                << "<script>CreateLatencyChart({test: \"" << EscapeJson(file) << " " << pass << " latency\", id: \"" << id << "\", codecs: [" << codecs << "]});</script>\n";
+        }
+    }
+
+    out << "</body>\n</html>\n";
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "CompressionTest.h"
+#include "CorpusGenerator.h"
+
+#include <iosfwd>
+
+// Command line options for the headless driver. Empty filters mean "everything".
+struct BenchmarkOptions
+{
+    vector<string> Codecs;
+    vector<string> Passes;
+    vector<string> DataDirs;
+    vector<string> Files;
+    vector<size_t> BlockSizes;
+    // message stream sizes, no message stream while MessageMax is 0
+    size_t MessageMin = 0;
+    size_t MessageMax = 0;
+    uint64_t MessageSeed = 1;
+    string CorpusDir;
+    string ArtifactDir;
+    CorpusGenerator::Options Corpus;
+    int Iterations = 5;
+    int Warmup = 1;
+    int PinCore = -1;
+    unsigned Threads = 0;
+    size_t ChunkSize = 64 * 1024;
+    bool StreamFlush = false;
+    string Format = "csv";
+    string Output;
+    string Save;
+    vector<string> Compare;
+    double Threshold = 0.02;
+    string CommandLine;
+    bool List = false;
+    bool Chart = false;
+    bool Perf = false;
+    bool Sweep = false;
+    bool Lzo = false;
+    // preset dictionary for the "-dict" codecs, loaded from a file or trained on a directory
+    string Dictionary;
+    string DictionaryTrainDir;
+    size_t DictionarySize = 32 * 1024;
+    // nanoseconds of compression per byte the auto codec may spend
+    double AutoBudget = 5;
+    // percent saving below which the "-early" codecs store a block, off while 0
+    double EarlyExit = 0;
+    // cores the "-parallel" zlib and gzip codecs compress on, off while 0
+    unsigned ParallelThreads = 0;
+    bool Cold = false;
+    size_t ScrubSize = 32 * 1024 * 1024;
+    bool Mmap = false;
+    MappedFile::Options Mapping;
+    PageAllocator::Options Pages;
+
+    bool Parse(int argc, char** argv);
+    static void PrintUsage(char const* program);
+
+    static bool IsSelected(vector<string> const& filter, char const* name);
+};
+
+// One codec x file x pass measurement. Metrics are kept in the order they were added so
+// every output format lists columns the same way.
+struct BenchmarkResult
+{
+    string Codec;
+    string File;
+    string Pass;
+    vector<pair<string, double>> Metrics;
+    // seconds of every timed iteration, kept so saved runs can be tested for significance
+    vector<double> Samples;
+
+    void AddMetric(char const* name, double value) { Metrics.push_back(make_pair(string(name), value)); }
+
+    double GetMetric(char const* name) const
+    {
+        for (auto const& metric : Metrics)
+        {
+            if (metric.first == name)
+                return metric.second;
+        }
+        return 0;
+    }
+};
+
+// Runs the CompressionTest passes directly and writes the results as csv or json, for
+// machines where the ChartJS page can't be opened.
+class Benchmark
+{
+public:
+    Benchmark(BenchmarkOptions const& options);
+
+    // Returns the process exit code.
+    int Run();
+
+    // Lines up two saved runs and flags significant speed or ratio changes. Returns 3 if
+    // anything regressed so it can gate a build.
+    int Compare() const;
+
+    static vector<unique_ptr<FileParameter const>> LoadFiles(BenchmarkOptions const& options);
+    // Every instance shares the one dictionary from LoadDictionary, null for none.
+    static vector<unique_ptr<CompressionTest>> CreateTests(BenchmarkOptions const& options, shared_ptr<vector<char> const> const& dictionary);
+    // Null without a dictionary option or if it couldn't be loaded or trained.
+    static shared_ptr<vector<char> const> LoadDictionary(BenchmarkOptions const& options);
+
+private:
+    // The selected codecs of every kind, before anything is attached to them.
+    static vector<unique_ptr<CompressionTest>> CreateCodecs(BenchmarkOptions const& options, shared_ptr<vector<char> const> const& dictionary);
+
+    // Fills in the names and the size metrics every output row starts with.
+    BenchmarkResult CreateResult(CompressionTest const& test, CompressionTest::PassFunctions const& pass, FileParameter const& file, size_t resultSize) const;
+
+    // Summarizes the measured seconds per iteration: min, mean, percentiles and a 95%
+    // confidence interval of the mean, so differences can be told apart from noise.
+    void AddTimings(BenchmarkResult& result, FileParameter const& file, vector<double> samples, unsigned threads) const;
+    void AddCounters(BenchmarkResult& result, FileParameter const& file, double const* totals) const;
+    void AddInitCost(BenchmarkResult& result, CompressionTest const& test, bool compress) const;
+    // Per call latency with warm caches next to the same calls after scrubbing the caches.
+    void AddCallLatency(BenchmarkResult& result, CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const;
+    // Histogram of every call's latency over separate runs, so the clock reads don't slow
+    // the throughput iterations. p50/p99/p99.9/max for message streams.
+    void AddLatencyHistogram(BenchmarkResult& result, CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const;
+    // Flags the rows on the compressed size vs MB/s frontier of their file and pass.
+    void AddPareto(vector<BenchmarkResult>& results) const;
+    void AddCallOverhead(vector<BenchmarkResult>& results, size_t first, size_t wholeFile) const;
+    // Compares every "streaming x" row with the "x" row of the same codec and file.
+    void AddStreamingOverhead(vector<BenchmarkResult>& results) const;
+    // Compares every "x-dict" codec row with the "x" row of the same file and pass.
+    void AddDictionaryGain(vector<BenchmarkResult>& results) const;
+    // Time saved and ratio given up by every "x-early" row against its "x" row.
+    void AddEarlyExitGain(vector<BenchmarkResult>& results) const;
+    // Speedup and ratio change of every "-parallel" row against the single threaded "zlib".
+    void AddParallelGain(vector<BenchmarkResult>& results) const;
+
+    BenchmarkResult RunPass(CompressionTest& test, CompressionTest::PassFunctions const& pass, FileParameter const& file) const;
+
+    // Runs 1..Options.Threads copies of one codec pass at once, each on its own core with its
+    // own instance and input copy, and reports aggregate throughput for every thread count.
+    vector<BenchmarkResult> RunScaling(size_t testIndex, size_t passIndex, FileParameter const& file) const;
+
+    // Build and host details saved with every run, so a comparison can tell what changed.
+    vector<pair<string, string>> CollectMetadata() const;
+
+    void WriteResults(vector<BenchmarkResult> const& results, ostream& out) const;
+    void WriteCsv(vector<BenchmarkResult> const& results, ostream& out) const;
+    void WriteJson(vector<BenchmarkResult> const& results, ostream& out) const;
+    // ChartJS scatter plots of ratio against MB/s per file with the Pareto frontier drawn in.
+    void WriteHtml(vector<BenchmarkResult> const& results, ostream& out) const;
+
+    BenchmarkOptions Options;
+
+    // Loaded or trained once up front, every instance's dictionary codecs share it.
+    shared_ptr<vector<char> const> Dictionary;
+
+    // One full set of tests per thread, index 0 is the one used for single threaded runs.
+    vector<vector<unique_ptr<CompressionTest>>> Instances;
+};
@@ -0,0 +1,87 @@
+#include "CompressibilityEstimator.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    int const MatchTableBits = 12;
+}
+
+CompressibilityEstimator::Estimate CompressibilityEstimator::Run(char const* data, size_t size)
+{
+    char sample[SampleSize];
+    return Measure(sample, TakeSample(data, size, sample));
+}
+
+size_t CompressibilityEstimator::TakeSample(char const* data, size_t size, char* sample)
+{
+    if (size <= SampleSize)
+    {
+        memcpy(sample, data, size);
+        return size;
+    }
+
+    size_t sliceSize = SampleSize / SliceCount;
+    size_t stride = (size - sliceSize) / (SliceCount - 1);
+    for (size_t slice = 0; slice < SliceCount; ++slice)
+        memcpy(sample + slice * sliceSize, data + slice * stride, sliceSize);
+    return SampleSize;
+}
+
+CompressibilityEstimator::Estimate CompressibilityEstimator::Measure(char const* data, size_t sampleSize)
+{
+    Estimate estimate = { 0, 0 };
+    if (sampleSize == 0)
+        return estimate;
+
+    unsigned char const* sample = (unsigned char const*)data;
+
+    // four interleaved histograms, so runs of the same byte don't wait on their own
+    // increments, summed at the end
+    uint32_t counts[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= sampleSize; i += 4)
+    {
+        uint32_t word;
+        memcpy(&word, sample + i, sizeof(word));
+        ++counts[0][word & 0xff];
+        ++counts[1][(word >> 8) & 0xff];
+        ++counts[2][(word >> 16) & 0xff];
+        ++counts[3][word >> 24];
+    }
+    for (; i < sampleSize; ++i)
+        ++counts[0][sample[i]];
+
+    for (int symbol = 0; symbol < 256; ++symbol)
+    {
+        uint32_t count = counts[0][symbol] + counts[1][symbol] + counts[2][symbol] + counts[3][symbol];
+        if (count)
+        {
+            double p = (double)count / sampleSize;
+            estimate.Entropy -= p * log2(p);
+        }
+    }
+
+    if (sampleSize < 4)
+        return estimate;
+
+    // the last quad seen with each hash, compared whole so there's no branch to mispredict
+    // on data that doesn't repeat. An empty slot matches a quad of zeros, which is as good
+    // as a repeat.
+    uint32_t table[1 << MatchTableBits] = {};
+    size_t matches = 0;
+    size_t probes = sampleSize - 3;
+    for (size_t i = 0; i < probes; ++i)
+    {
+        uint32_t quad;
+        memcpy(&quad, sample + i, sizeof(quad));
+        uint32_t& entry = table[(quad * 2654435761u) >> (32 - MatchTableBits)];
+        matches += entry == quad;
+        entry = quad;
+    }
+    estimate.MatchFraction = (double)matches / probes;
+
+    return estimate;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// Guesses how well a block will compress from a few KB of it, for far less than running a
+// codec: the order 0 entropy of the sampled bytes and how often a 4 byte sequence repeats
+// one seen shortly before. Text and structured data show up as low entropy or many
+// repeats, media and already compressed data as neither.
+class CompressibilityEstimator
+{
+public:
+    struct Estimate
+    {
+        // bits per byte, 8 for uniformly random bytes
+        double Entropy;
+        // share of sampled positions whose next 4 bytes were seen before in the sample
+        double MatchFraction;
+
+        // Rough share of the size a fast codec would save: the better of what the byte
+        // frequencies alone allow and the share of positions a match could cover.
+        double GetSaving() const
+        {
+            double entropySaving = 1 - Entropy / 8;
+            return entropySaving > MatchFraction ? entropySaving : MatchFraction;
+        }
+    };
+
+    static Estimate Run(char const* data, size_t size);
+
+    // The same in two steps, for callers that want to try codecs on the sample too. Big
+    // blocks are sampled as four slices spread over the block so a header doesn't decide
+    // for it, small ones are taken whole. Returns the sample size.
+    static size_t const SampleSize = 4096;
+    static size_t TakeSample(char const* data, size_t size, char* sample);
+    static Estimate Measure(char const* sample, size_t size);
+
+private:
+    static size_t const SliceCount = 4;
+};
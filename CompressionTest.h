@@ -0,0 +1,629 @@
+#pragma once
+
+#include "ArtifactCache.h"
+#include "CompressibilityEstimator.h"
+#include "Bootstrap.h"
+#include "File.h"
+#include "MappedFile.h"
+#include "PageAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Read only window onto input bytes, which live either in a vector or in a file mapping.
+// Named like the vector members so codecs use it the same way.
+class ByteView
+{
+public:
+    ByteView()
+        : Data(nullptr)
+        , Size(0)
+    {
+    }
+
+    ByteView(char const* data, size_t size)
+        : Data(data)
+        , Size(size)
+    {
+    }
+
+    template <typename Allocator>
+    ByteView(vector<char, Allocator> const& data)
+        : Data(data.data())
+        , Size(data.size())
+    {
+    }
+
+    char const* data() const { return Data; }
+    size_t size() const { return Size; }
+    bool empty() const { return Size == 0; }
+
+private:
+    char const* Data;
+    size_t Size;
+};
+
+// The bytes behind a file parameter, shared with its block splits. Either a copy read
+// up front or a mapping that's only made the first time the data is needed.
+class FileSource
+{
+public:
+    FileSource(vector<char>&& data)
+        : Copy(move(data))
+        , Size(Copy.size())
+    {
+    }
+
+    FileSource(char const* path, size_t size, MappedFile::Options const& options)
+        : Path(path)
+        , Size(size)
+        , MapOptions(options)
+    {
+    }
+
+    ByteView GetData() const
+    {
+        if (Path.empty())
+            return ByteView(Copy);
+
+        if (!Mapping)
+        {
+            Mapping.reset(new MappedFile(Path.c_str(), MapOptions));
+            if (!Mapping->IsValid() || Mapping->GetSize() != Size)
+            {
+                fprintf(stderr, "couldn't map %s\n", Path.c_str());
+                abort();
+            }
+        }
+        return ByteView(Mapping->GetData(), Mapping->GetSize());
+    }
+
+    size_t GetSize() const { return Size; }
+    bool IsMapped() const { return !Path.empty(); }
+    double GetPrefaultSeconds() const { return Mapping ? Mapping->GetPrefaultSeconds() : 0; }
+
+private:
+    vector<char> Copy;
+    string Path;
+    size_t Size;
+    MappedFile::Options MapOptions;
+    mutable unique_ptr<MappedFile> Mapping;
+};
+
+class FileParameter : public Parameter, public NamedObject
+{
+public:
+    FileParameter(const char* filename)
+        : NamedObject(GetFileName(filename))
+        , SourceName(GetFileName(filename))
+        , Source(make_shared<FileSource>(File::ReadFile(filename)))
+        , BlockSize(0)
+        , Hash(0)
+    {
+
+    }
+
+    FileParameter(const char* filename, size_t size)
+        : NamedObject(GetFileName(filename))
+        , SourceName(GetFileName(filename))
+        , Source(make_shared<FileSource>(File::ReadFile(filename, size)))
+        , BlockSize(0)
+        , Hash(0)
+    {
+
+    }
+
+    // Maps the file instead of reading it, for inputs too big to copy into memory. Nothing
+    // is mapped until a pass first needs the data.
+    FileParameter(const char* filename, size_t size, MappedFile::Options const& options)
+        : NamedObject(GetFileName(filename))
+        , SourceName(GetFileName(filename))
+        , Source(make_shared<FileSource>(filename, size, options))
+        , BlockSize(0)
+        , Hash(0)
+    {
+
+    }
+
+    // Splits a whole file into blockSize pieces that get compressed independently, to
+    // match services that compress one record at a time. The last block may be shorter.
+    // The blocks point into the whole file's data rather than copying it.
+    FileParameter(FileParameter const& file, size_t blockSize)
+        : NamedObject((file.SourceName + "@" + FormatSize(blockSize)).c_str())
+        , SourceName(file.SourceName)
+        , Source(file.Source)
+        , BlockSize(blockSize)
+        , Hash(0)
+    {
+        assert(file.BlockSize == 0 && blockSize > 0);
+    }
+
+    // Splits a whole file into a stream of messages between minSize and maxSize bytes, like
+    // the records an RPC layer compresses one by one. Sizes are log uniform so small messages
+    // dominate, and only depend on the seed.
+    FileParameter(FileParameter const& file, size_t minSize, size_t maxSize, uint64_t seed)
+        : NamedObject((file.SourceName + "@msg" + FormatSize(minSize) + "-" + FormatSize(maxSize)).c_str())
+        , SourceName(file.SourceName)
+        , Source(file.Source)
+        , BlockSize(maxSize)
+        , Hash(0)
+    {
+        assert(file.BlockSize == 0 && minSize > 0 && minSize <= maxSize);
+
+        double range = log((double)maxSize / minSize);
+        for (size_t offset = 0; offset < Source->GetSize(); offset += MessageSizes.back())
+        {
+            // splitmix64
+            uint64_t random = (seed += 0x9e3779b97f4a7c15ull);
+            random = (random ^ (random >> 30)) * 0xbf58476d1ce4e5b9ull;
+            random = (random ^ (random >> 27)) * 0x94d049bb133111ebull;
+            random ^= random >> 31;
+
+            double unit = (random >> 11) * (1.0 / 9007199254740992.0);
+            size_t size = min((size_t)(minSize * exp(unit * range)), maxSize);
+            MessageSizes.push_back(min(size, Source->GetSize() - offset));
+        }
+    }
+
+    // Copies the bytes, mapped or not, so every scaling thread reads its own memory.
+    FileParameter(FileParameter const& file)
+        : Parameter(file)
+        , NamedObject(file)
+        , SourceName(file.SourceName)
+        , BlockSize(file.BlockSize)
+        , MessageSizes(file.MessageSizes)
+        , Hash(file.Hash)
+    {
+        ByteView data = file.Source->GetData();
+        Source = make_shared<FileSource>(vector<char>(data.data(), data.data() + data.size()));
+    }
+
+    string ToString() const override { return GetName(); }
+    int64_t Max() const override { return Source->GetSize(); }
+
+    // The whole file is a single block unless it was split into blocks or messages. Mapped
+    // files get mapped on the first call.
+    vector<ByteView> const& Blocks() const
+    {
+        if (FileBlocks.empty())
+        {
+            ByteView data = Source->GetData();
+            if (BlockSize == 0)
+                FileBlocks.push_back(data);
+
+            size_t offset = 0;
+            for (size_t size : MessageSizes)
+            {
+                FileBlocks.push_back(ByteView(data.data() + offset, size));
+                offset += size;
+            }
+
+            for (; BlockSize && MessageSizes.empty() && offset < data.size(); offset += BlockSize)
+                FileBlocks.push_back(ByteView(data.data() + offset, min(BlockSize, data.size() - offset)));
+        }
+        return FileBlocks;
+    }
+
+    // Largest block, 0 for a whole file.
+    size_t GetBlockSize() const { return BlockSize; }
+    bool IsWholeFile() const { return BlockSize == 0; }
+    bool IsMessageStream() const { return !MessageSizes.empty(); }
+    char const* GetSourceName() const { return SourceName.c_str(); }
+    bool IsMapped() const { return Source->IsMapped(); }
+    double GetPrefaultSeconds() const { return Source->GetPrefaultSeconds(); }
+
+    // Identifies the content for the artifact cache, worked out on first use.
+    uint64_t GetHash() const
+    {
+        if (!Hash)
+        {
+            ByteView data = Source->GetData();
+            Hash = ArtifactCache::Hash(data.data(), data.size());
+            Hash = ArtifactCache::Hash((char const*)&BlockSize, sizeof(BlockSize), Hash);
+            Hash = ArtifactCache::Hash((char const*)MessageSizes.data(), MessageSizes.size() * sizeof(size_t), Hash);
+        }
+        return Hash;
+    }
+
+    static string FormatSize(size_t size)
+    {
+        char buffer[32];
+        if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+            snprintf(buffer, sizeof(buffer), "%zuMB", size / (1024 * 1024));
+        else if (size >= 1024 && size % 1024 == 0)
+            snprintf(buffer, sizeof(buffer), "%zuKB", size / 1024);
+        else
+            snprintf(buffer, sizeof(buffer), "%zuB", size);
+        return buffer;
+    }
+
+private:
+    static const char* GetFileName(const char* path)
+    {
+        const char* lastSlash = path;
+        for (const char* i = path; *i; ++i)
+        {
+            if (*i == '\\' || *i == '/')
+                lastSlash = i + 1;
+        }
+        return lastSlash;
+    }
+
+    string SourceName;
+    shared_ptr<FileSource const> Source;
+    size_t BlockSize;
+    vector<size_t> MessageSizes;
+    mutable vector<ByteView> FileBlocks;
+    mutable uint64_t Hash;
+};
+
+class CompressionTest : public CodeTest
+{
+public:
+    // Mirror of what was registered with SetPass/SetPassSetup/SetPassTeardown, so the
+    // command line driver can run the same passes without the CodeCompare bootstrap.
+    struct PassFunctions
+    {
+        string Name;
+        bool Compress;
+        function<void(Parameter const*)> Setup;
+        function<size_t(Parameter const*)> Run;
+        function<void(Parameter const*)> Teardown;
+    };
+
+    char const* GetCodecName() const { return CodecName.c_str(); }
+    vector<PassFunctions> const& GetPasses() const { return Passes; }
+    size_t GetWorkMemorySize(bool compress) const { return WorkMemorySize(compress); }
+    bool GetReuseContext() const { return ReuseContext; }
+
+    // Times every block call on its own for per call latency, running evict (if set) before
+    // each one so the call starts with caches full of someone else's data. The timings of
+    // the last pass run are kept.
+    void SetCallTiming(bool enabled, function<void()> evict)
+    {
+        TimeCalls = enabled;
+        Evict = evict;
+    }
+    vector<double> const& GetCallSeconds() const { return CallSeconds; }
+
+    // Codec specific results of the last pass run, added to its row as extra metrics.
+    virtual vector<pair<string, double>> GetPassMetrics(bool /*compress*/) const { return vector<pair<string, double>>(); }
+
+    // Decompression setup loads its input from the cache, only compressing (and storing the
+    // result) when there's no artifact for this codec, mode and file yet.
+    void SetArtifactCache(shared_ptr<ArtifactCache const> cache) { Artifacts = cache; }
+
+    // Builds and frees the codec context once so its cost can be timed on its own,
+    // false if the codec doesn't have one. Not valid between a pass setup and teardown.
+    bool InitContext(bool compress) const
+    {
+        if (!CreateContext(compress))
+            return false;
+        DestroyContext(compress);
+        return true;
+    }
+
+    // Input chunk size for the streaming passes, and whether the stream is flushed after
+    // every chunk like a message based protocol would.
+    void SetStreaming(size_t chunkSize, bool flush)
+    {
+        StreamChunkSize = chunkSize;
+        StreamFlush = flush;
+    }
+
+    // Runs the compressibility estimator before every block and keeps the blocks it predicts
+    // would save less than minSaving (0.05 for 5%) as they are, flagged the way a container
+    // would. The codec is renamed "x-early" so it's reported next to the plain one.
+    void SetEarlyExit(double minSaving)
+    {
+        MinSaving = minSaving;
+        CodecName += "-early";
+    }
+    bool HasEarlyExit() const { return MinSaving > 0; }
+    // Share of the last pass's blocks that skipped the codec.
+    double GetPassthroughShare() const
+    {
+        size_t stored = count(Passthrough.begin(), Passthrough.end(), 1);
+        return Passthrough.empty() ? 0 : (double)stored / Passthrough.size();
+    }
+
+protected:
+    CompressionTest(char const* name, bool reuseContext = false)
+        : CodeTest(name)
+        , ReuseContext(reuseContext)
+        , StreamChunkSize(64 * 1024)
+        , StreamFlush(false)
+        , CodecName(name)
+        , TimeCalls(false)
+        , DictionaryHash(0)
+        , MinSaving(0)
+    {
+        AddPass("compression", true,
+            [this](Parameter const* param) { return Compress(*(FileParameter const*)param, false); },
+            [this](Parameter const* param) { CompressSetup(*(FileParameter const*)param, false); },
+            [this](Parameter const* param) { CompressTeardown(*(FileParameter const*)param); });
+
+        AddPass("decompression", false,
+            [this](Parameter const* param) { return Decompress(*(FileParameter const*)param, false); },
+            [this](Parameter const* param) { DecompressSetup(*(FileParameter const*)param, false); },
+            [this](Parameter const* param) { DecompressTeardown(*(FileParameter const*)param); });
+    }
+
+    // For codecs that implement DoStreamCompress/DoStreamDecompress.
+    void AddStreamingPasses()
+    {
+        AddPass("streaming compression", true,
+            [this](Parameter const* param) { return Compress(*(FileParameter const*)param, true); },
+            [this](Parameter const* param) { CompressSetup(*(FileParameter const*)param, true); },
+            [this](Parameter const* param) { CompressTeardown(*(FileParameter const*)param); });
+
+        AddPass("streaming decompression", false,
+            [this](Parameter const* param) { return Decompress(*(FileParameter const*)param, true); },
+            [this](Parameter const* param) { DecompressSetup(*(FileParameter const*)param, true); },
+            [this](Parameter const* param) { DecompressTeardown(*(FileParameter const*)param); });
+    }
+
+    void AddPass(char const* name, bool compress, function<size_t(Parameter const*)> pass, function<void(Parameter const*)> setup, function<void(Parameter const*)> teardown)
+    {
+        SetPass(name, pass);
+        SetPassSetup(name, setup);
+        SetPassTeardown(name, teardown);
+
+        PassFunctions functions;
+        functions.Name = name;
+        functions.Compress = compress;
+        functions.Setup = setup;
+        functions.Run = pass;
+        functions.Teardown = teardown;
+        Passes.push_back(functions);
+    }
+
+    virtual size_t CompressionSize(size_t sourceSize) const = 0;
+    virtual void DoCompress(ByteView sourceData, CodecBuffer& destData) const = 0;
+    virtual void DoDecompress(ByteView sourceData, CodecBuffer& destData) const = 0;
+
+    // Scratch memory a codec keeps outside the heap, e.g. LZO's work memory on the stack,
+    // so it can be reported next to the tracked heap allocations.
+    virtual size_t WorkMemorySize(bool /*compress*/) const { return 0; }
+
+    // Streaming feeds the input to the codec StreamChunkSize bytes at a time through its
+    // incremental API, decompression gets the compressed stream in the same size pieces.
+    virtual size_t StreamCompressionSize(size_t sourceSize) const
+    {
+        size_t chunks = sourceSize / StreamChunkSize + 1;
+        return chunks * (CompressionSize(StreamChunkSize) + FrameHeaderSize);
+    }
+    virtual void DoStreamCompress(ByteView /*sourceData*/, CodecBuffer& /*destData*/) const { assert(false); }
+    virtual void DoStreamDecompress(ByteView /*sourceData*/, CodecBuffer& /*destData*/) const { assert(false); }
+
+    // Block framing for codecs without a streaming format of their own: every chunk is
+    // stored as its compressed size and raw size, followed by the compressed bytes.
+    static size_t const FrameHeaderSize = 2 * sizeof(uint32_t);
+
+    template <typename CompressChunk>
+    void FrameChunks(ByteView sourceData, CodecBuffer& destData, CompressChunk compressChunk) const
+    {
+        size_t offset = 0;
+        size_t out = 0;
+        do
+        {
+            uint32_t size = (uint32_t)min(StreamChunkSize, sourceData.size() - offset);
+            uint32_t compressed = (uint32_t)compressChunk(sourceData.data() + offset, size, destData.data() + out + FrameHeaderSize, destData.size() - out - FrameHeaderSize);
+
+            memcpy(destData.data() + out, &compressed, sizeof(compressed));
+            memcpy(destData.data() + out + sizeof(compressed), &size, sizeof(size));
+
+            offset += size;
+            out += FrameHeaderSize + compressed;
+        }
+        while (offset < sourceData.size());
+
+        destData.resize(out);
+    }
+
+    template <typename DecompressChunk>
+    void UnframeChunks(ByteView sourceData, CodecBuffer& destData, DecompressChunk decompressChunk) const
+    {
+        size_t in = 0;
+        size_t out = 0;
+        while (in < sourceData.size())
+        {
+            uint32_t compressed;
+            uint32_t size;
+            memcpy(&compressed, sourceData.data() + in, sizeof(compressed));
+            memcpy(&size, sourceData.data() + in + sizeof(compressed), sizeof(size));
+
+            decompressChunk(sourceData.data() + in + FrameHeaderSize, compressed, destData.data() + out, size);
+
+            in += FrameHeaderSize + compressed;
+            out += size;
+        }
+        assert(out == destData.size());
+    }
+
+    // State a codec would otherwise build on every call, like zlib's streams or lzo's work
+    // memory. With ReuseContext it's created once per pass setup and only reset per call.
+    virtual bool CreateContext(bool /*compress*/) const { return false; }
+    virtual void DestroyContext(bool /*compress*/) const {}
+
+    virtual void Setup(bool /*compress*/) {}
+    virtual void Teardown(bool /*compress*/) {}
+
+    // Preset dictionary for the codecs that take one, shared by every instance using it.
+    void SetDictionary(shared_ptr<vector<char> const> dictionary)
+    {
+        Dictionary = dictionary;
+        DictionaryHash = ArtifactCache::Hash(dictionary->data(), dictionary->size());
+    }
+    ByteView GetDictionary() const { return Dictionary ? ByteView(*Dictionary) : ByteView(); }
+
+    bool const ReuseContext;
+    size_t StreamChunkSize;
+    bool StreamFlush;
+
+private:
+    template <typename Call>
+    void RunCall(Call call)
+    {
+        if (!TimeCalls)
+        {
+            call();
+            return;
+        }
+
+        if (Evict)
+            Evict();
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        call();
+        CallSeconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    size_t Compress(FileParameter const& source, bool streaming)
+    {
+        vector<ByteView> const& blocks = source.Blocks();
+        CallSeconds.clear();
+
+        size_t size = 0;
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            RunCall([&] { CompressBlock(blocks, i, streaming); });
+            size += CompressedData[i].size();
+        }
+        return size;
+    }
+
+    void CompressBlock(vector<ByteView> const& blocks, size_t i, bool streaming)
+    {
+        Passthrough[i] = IsIncompressible(blocks[i]);
+        if (Passthrough[i])
+            CompressedData[i].assign(blocks[i].data(), blocks[i].data() + blocks[i].size());
+        else if (streaming)
+            DoStreamCompress(blocks[i], CompressedData[i]);
+        else
+            DoCompress(blocks[i], CompressedData[i]);
+    }
+
+    bool IsIncompressible(ByteView block) const
+    {
+        return MinSaving > 0 && CompressibilityEstimator::Run(block.data(), block.size()).GetSaving() < MinSaving;
+    }
+
+    void CompressSetup(FileParameter const& source, bool streaming)
+    {
+        Setup(true);
+        if (ReuseContext)
+            CreateContext(true);
+
+        vector<ByteView> const& blocks = source.Blocks();
+        CompressedData.resize(blocks.size());
+        Passthrough.assign(blocks.size(), 0);
+        for (size_t i = 0; i < blocks.size(); ++i)
+            CompressedData[i].resize(streaming ? StreamCompressionSize(blocks[i].size()) : CompressionSize(blocks[i].size()));
+    }
+
+    void CompressTeardown(FileParameter const& source)
+    {
+        CompressedData = vector<CodecBuffer>();
+        if (ReuseContext)
+            DestroyContext(true);
+        Teardown(true);
+    }
+
+    size_t Decompress(FileParameter const& source, bool streaming)
+    {
+        CallSeconds.clear();
+
+        size_t size = 0;
+        for (size_t i = 0; i < CompressedData.size(); ++i)
+        {
+            RunCall([&]
+            {
+                if (Passthrough[i])
+                    memcpy(UnCompressedData[i].data(), CompressedData[i].data(), CompressedData[i].size());
+                else if (streaming)
+                    DoStreamDecompress(CompressedData[i], UnCompressedData[i]);
+                else
+                    DoDecompress(CompressedData[i], UnCompressedData[i]);
+            });
+            size += UnCompressedData[i].size();
+        }
+        return size;
+    }
+
+    void DecompressSetup(FileParameter const& source, bool streaming)
+    {
+        Setup(false);
+        if (ReuseContext)
+            CreateContext(false);
+        CompressSetup(source, streaming);
+
+        vector<ByteView> const& blocks = source.Blocks();
+        string key = GetArtifactKey(source, streaming);
+        bool cached = Artifacts && Artifacts->Load(key, source.GetHash(), blocks.size(), CompressedData);
+
+        UnCompressedData.resize(blocks.size());
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            // the estimate is deterministic, a cached artifact gets the same flags back
+            if (cached)
+                Passthrough[i] = IsIncompressible(blocks[i]);
+            else
+                CompressBlock(blocks, i, streaming);
+            UnCompressedData[i].resize(blocks[i].size());
+        }
+
+        if (Artifacts && !cached)
+            Artifacts->Store(key, source.GetHash(), CompressedData);
+    }
+
+    // everything that changes the compressed bytes besides the input itself
+    string GetArtifactKey(FileParameter const& source, bool streaming) const
+    {
+        string key = CodecName;
+        if (streaming)
+            key += "-stream" + to_string(StreamChunkSize) + (StreamFlush ? "-flush" : "");
+        if (Dictionary)
+            key += "-" + to_string(DictionaryHash);
+        if (MinSaving > 0)
+            key += "-" + to_string((int)(MinSaving * 1000));
+        return key + "-" + source.GetName();
+    }
+
+    void DecompressTeardown(FileParameter const& source)
+    {
+        vector<ByteView> const& blocks = source.Blocks();
+        assert(blocks.size() == UnCompressedData.size());
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            assert(blocks[i].size() == UnCompressedData[i].size());
+            assert(memcmp(blocks[i].data(), UnCompressedData[i].data(), UnCompressedData[i].size()) == 0);
+        }
+
+        UnCompressedData = vector<CodecBuffer>();
+        CompressTeardown(source);
+        if (ReuseContext)
+            DestroyContext(false);
+        Teardown(false);
+    }
+
+    string CodecName;
+    vector<PassFunctions> Passes;
+    bool TimeCalls;
+    function<void()> Evict;
+    shared_ptr<ArtifactCache const> Artifacts;
+    shared_ptr<vector<char> const> Dictionary;
+    uint64_t DictionaryHash;
+    double MinSaving;
+    vector<double> CallSeconds;
+    // one entry per input block
+    vector<CodecBuffer> CompressedData;
+    vector<CodecBuffer> UnCompressedData;
+    // blocks kept as they are by the early exit
+    vector<char> Passthrough;
+};
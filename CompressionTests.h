@@ -0,0 +1,1365 @@
+#pragma once
+
+#include "CompressionTest.h"
+#include "PageAllocator.h"
+
+#include "lz4/lib/lz4.h"
+#include "lz4/lib/lz4frame.h"
+
+class LZ4Test : public CompressionTest
+{
+public:
+    LZ4Test() : CompressionTest("lz4") { AddStreamingPasses(); }
+
+protected:
+    LZ4Test(char const* name, bool reuse) : CompressionTest(name, reuse) {}
+
+    // only the reuse variant keeps its state, the plain one builds it on the stack every call
+    bool CreateContext(bool compress) const override
+    {
+        if (!ReuseContext || !compress)
+            return false;
+
+        State.reset(new LZ4_stream_t);
+        LZ4_resetStream(State.get());
+        return true;
+    }
+    void DestroyContext(bool /*compress*/) const override
+    {
+        State.reset();
+    }
+
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return LZ4_compressBound(sourceSize);
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        // LZ4_compress_fast keeps its hash table on the stack
+        return compress ? LZ4_sizeofState() : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = ReuseContext
+            ? LZ4_compress_fast_extState(State.get(), sourceData.data(), destData.data(), sourceData.size(), destData.size(), 1)
+            : LZ4_compress_default(sourceData.data(), destData.data(), sourceData.size(), destData.size());
+        assert(result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_decompress_safe(sourceData.data(), destData.data(), sourceData.size(), destData.size());
+        assert(result >= 0 && result == destData.size());
+    }
+
+    // streaming goes through the lz4 frame format
+    size_t StreamCompressionSize(size_t sourceSize) const override
+    {
+        size_t chunks = sourceSize / StreamChunkSize + 1;
+        return chunks * LZ4F_compressBound(StreamChunkSize, NULL) + LZ4F_compressBound(0, NULL) + 32;
+    }
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        LZ4F_compressionContext_t context;
+        LZ4F_errorCode_t error = LZ4F_createCompressionContext(&context, LZ4F_VERSION);
+        assert(!LZ4F_isError(error));
+
+        size_t out = LZ4F_compressBegin(context, destData.data(), destData.size(), NULL);
+        assert(!LZ4F_isError(out));
+
+        for (size_t offset = 0; offset < sourceData.size(); offset += StreamChunkSize)
+        {
+            size_t size = min(StreamChunkSize, sourceData.size() - offset);
+            size_t result = LZ4F_compressUpdate(context, destData.data() + out, destData.size() - out, sourceData.data() + offset, size, NULL);
+            assert(!LZ4F_isError(result));
+            out += result;
+
+            if (StreamFlush)
+            {
+                result = LZ4F_flush(context, destData.data() + out, destData.size() - out, NULL);
+                assert(!LZ4F_isError(result));
+                out += result;
+            }
+        }
+
+        size_t result = LZ4F_compressEnd(context, destData.data() + out, destData.size() - out, NULL);
+        assert(!LZ4F_isError(result));
+        destData.resize(out + result);
+
+        LZ4F_freeCompressionContext(context);
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        LZ4F_decompressionContext_t context;
+        LZ4F_errorCode_t error = LZ4F_createDecompressionContext(&context, LZ4F_VERSION);
+        assert(!LZ4F_isError(error));
+
+        size_t in = 0;
+        size_t out = 0;
+        size_t hint = 1;
+        while (in < sourceData.size() && hint != 0)
+        {
+            size_t inSize = min(StreamChunkSize, sourceData.size() - in);
+            size_t outSize = destData.size() - out;
+            hint = LZ4F_decompress(context, destData.data() + out, &outSize, sourceData.data() + in, &inSize, NULL);
+            assert(!LZ4F_isError(hint));
+            in += inSize;
+            out += outSize;
+        }
+        assert(hint == 0 && out == destData.size());
+
+        LZ4F_freeDecompressionContext(context);
+    }
+
+private:
+    mutable unique_ptr<LZ4_stream_t> State;
+};
+
+class LZ4ReuseTest : public LZ4Test
+{
+public:
+    LZ4ReuseTest() : LZ4Test("lz4-reuse", true) {}
+};
+
+class LZ4FastTest : public CompressionTest
+{
+public:
+    LZ4FastTest() : CompressionTest("lz4Fast") { AddStreamingPasses(); }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return LZ4_compressBound(sourceSize);
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        // LZ4_compress_fast keeps its hash table on the stack
+        return compress ? LZ4_sizeofState() : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_compress_fast(sourceData.data(), destData.data(), sourceData.size(), destData.size(), 10);
+        assert(result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_decompress_fast(sourceData.data(), destData.data(), destData.size());
+        assert(result >= 0 && result == sourceData.size());
+    }
+
+    // streaming uses the block api with the previous chunks as dictionary
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        LZ4_stream_t stream;
+        LZ4_resetStream(&stream);
+
+        FrameChunks(sourceData, destData, [&stream](char const* source, size_t size, char* dest, size_t capacity)
+        {
+            int result = LZ4_compress_fast_continue(&stream, source, dest, size, capacity, 10);
+            assert(result > 0 || size == 0);
+            return (size_t)result;
+        });
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        LZ4_streamDecode_t stream;
+        LZ4_setStreamDecode(&stream, NULL, 0);
+
+        UnframeChunks(sourceData, destData, [&stream](char const* source, size_t size, char* dest, size_t destSize)
+        {
+            int result = LZ4_decompress_safe_continue(&stream, source, dest, size, destSize);
+            assert(result >= 0 && result == (int)destSize);
+        });
+    }
+};
+
+class LZ4AccelerationTest : public CompressionTest
+{
+public:
+    LZ4AccelerationTest(int acceleration)
+        : CompressionTest(("lz4-a" + to_string(acceleration)).c_str())
+        , Acceleration(acceleration)
+    {
+    }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return LZ4_compressBound(sourceSize);
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? LZ4_sizeofState() : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_compress_fast(sourceData.data(), destData.data(), sourceData.size(), destData.size(), Acceleration);
+        assert(result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_decompress_safe(sourceData.data(), destData.data(), sourceData.size(), destData.size());
+        assert(result >= 0 && result == (int)destData.size());
+    }
+
+private:
+    int const Acceleration;
+};
+
+#include "lz4/lib/lz4hc.h"
+
+class LZ4HCTest : public CompressionTest
+{
+public:
+    LZ4HCTest(int level)
+        : CompressionTest(("lz4hc-" + to_string(level)).c_str())
+        , Level(level)
+    {
+    }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return LZ4_compressBound(sourceSize);
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        // allocated with malloc inside LZ4_compress_HC so the tracker doesn't see it
+        return compress ? LZ4_sizeofStateHC() : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_compress_HC(sourceData.data(), destData.data(), sourceData.size(), destData.size(), Level);
+        assert(result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        int result = LZ4_decompress_safe(sourceData.data(), destData.data(), sourceData.size(), destData.size());
+        assert(result >= 0 && result == (int)destData.size());
+    }
+
+private:
+    int const Level;
+};
+
+// LZ4_loadDict indexes the dictionary once in setup, every call then starts from a copy
+// of that stream so records stay independent. Only the last 64KB of the dictionary can
+// be referenced.
+class LZ4DictTest : public CompressionTest
+{
+public:
+    LZ4DictTest(shared_ptr<vector<char> const> dictionary)
+        : CompressionTest("lz4-dict")
+    {
+        SetDictionary(dictionary);
+    }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return LZ4_compressBound(sourceSize);
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? 2 * sizeof(LZ4_stream_t) : 0;
+    }
+    void Setup(bool compress) override
+    {
+        if (!compress)
+            return;
+
+        ByteView dictionary = GetDictionary();
+        DictState.reset(new LZ4_stream_t);
+        State.reset(new LZ4_stream_t);
+        LZ4_resetStream(DictState.get());
+        LZ4_loadDict(DictState.get(), dictionary.data(), dictionary.size());
+    }
+    void Teardown(bool compress) override
+    {
+        if (!compress)
+            return;
+
+        DictState.reset();
+        State.reset();
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        memcpy(State.get(), DictState.get(), sizeof(LZ4_stream_t));
+        int result = LZ4_compress_fast_continue(State.get(), sourceData.data(), destData.data(), sourceData.size(), destData.size(), 1);
+        assert(result > 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        ByteView dictionary = GetDictionary();
+        int result = LZ4_decompress_safe_usingDict(sourceData.data(), destData.data(), sourceData.size(), destData.size(), dictionary.data(), dictionary.size());
+        assert(result >= 0 && result == (int)destData.size());
+    }
+
+private:
+    unique_ptr<LZ4_stream_t> DictState;
+    unique_ptr<LZ4_stream_t> State;
+};
+
+#include "snappy/snappy-c.h"
+
+class SnappyTest : public CompressionTest
+{
+public:
+    SnappyTest() : CompressionTest("Snappy") { AddStreamingPasses(); }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return snappy_max_compressed_length(sourceSize);
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        size_t result = destData.size();
+        snappy_status status = snappy_compress(sourceData.data(), sourceData.size(), destData.data(), &result);
+        assert(status == SNAPPY_OK && result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        size_t result = destData.size();
+        snappy_status status = snappy_uncompress(sourceData.data(), sourceData.size(), destData.data(), &result);
+        assert(status == SNAPPY_OK && result == destData.size());
+    }
+
+    // the c api has no stream, each chunk is compressed on its own
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        FrameChunks(sourceData, destData, [](char const* source, size_t size, char* dest, size_t capacity)
+        {
+            size_t result = capacity;
+            snappy_status status = snappy_compress(source, size, dest, &result);
+            assert(status == SNAPPY_OK);
+            return result;
+        });
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        UnframeChunks(sourceData, destData, [](char const* source, size_t size, char* dest, size_t destSize)
+        {
+            size_t result = destSize;
+            snappy_status status = snappy_uncompress(source, size, dest, &result);
+            assert(status == SNAPPY_OK && result == destSize);
+        });
+    }
+};
+
+#include "zlib/zlib.h"
+
+// Hands freed blocks back out to the next allocation of the same size, so zlib's
+// init/end per call stops going to the heap once every size has been seen.
+class BlockPool
+{
+public:
+    ~BlockPool()
+    {
+        assert(Used.empty());
+        for (auto const& block : Unused)
+            PageAllocator::Free(block.second);
+    }
+
+    void* Allocate(size_t size)
+    {
+        void* address = nullptr;
+        for (size_t i = 0; i < Unused.size() && !address; ++i)
+        {
+            if (Unused[i].first == size)
+            {
+                address = Unused[i].second;
+                Unused[i] = Unused.back();
+                Unused.pop_back();
+            }
+        }
+
+        if (!address)
+            address = PageAllocator::Allocate(size);
+
+        Used.push_back(make_pair(size, address));
+        return address;
+    }
+
+    void Free(void* address)
+    {
+        for (size_t i = 0; i < Used.size(); ++i)
+        {
+            if (Used[i].second == address)
+            {
+                Unused.push_back(Used[i]);
+                Used[i] = Used.back();
+                Used.pop_back();
+                return;
+            }
+        }
+        assert(false);
+    }
+
+private:
+    // zlib only has a handful of blocks live at once so a list is plenty
+    vector<pair<size_t, void*>> Used;
+    vector<pair<size_t, void*>> Unused;
+};
+
+class ZLibTest : public CompressionTest
+{
+public:
+    ZLibTest() : ZLibTest("zlib", false, false) { AddStreamingPasses(); }
+
+protected:
+    // reuse keeps one stream per direction and resets it between calls, pooled still
+    // inits per call but serves the allocations from a BlockPool
+    ZLibTest(char const* name, bool reuse, bool pooled, int level = Z_DEFAULT_COMPRESSION, int strategy = Z_DEFAULT_STRATEGY)
+        : CompressionTest(name, reuse)
+        , Pooled(pooled)
+        , Level(level)
+        , Strategy(strategy)
+    {
+    }
+
+    static voidpf alloc(voidpf opaque, uInt items, uInt size)
+    {
+        if (opaque)
+            return ((BlockPool*)opaque)->Allocate(items*size);
+        return PageAllocator::Allocate(items*size);
+    }
+    static void free(voidpf opaque, voidpf address)
+    {
+        if (opaque)
+            ((BlockPool*)opaque)->Free(address);
+        else
+            PageAllocator::Free(address);
+    }
+
+    bool CreateContext(bool compress) const override
+    {
+        z_stream& strm = compress ? DeflateStream : InflateStream;
+        strm.zalloc = &alloc;
+        strm.zfree = &free;
+        strm.opaque = Pooled ? &Pool : Z_NULL;
+
+        int status = compress ? deflateInit2(&strm, Level, Z_DEFLATED, MAX_WBITS, 8, Strategy) : inflateInit(&strm);
+        assert(status == Z_OK);
+        return true;
+    }
+    void DestroyContext(bool compress) const override
+    {
+        if (compress)
+            deflateEnd(&DeflateStream);
+        else
+            inflateEnd(&InflateStream);
+    }
+
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        // the header names a preset dictionary by its 4 byte adler32, neither bound counts it
+        size_t dictionaryId = GetDictionary().empty() ? 0 : 4;
+
+        // fixed codes can't always fall back to stored blocks and expand incompressible
+        // input past compressBound, this is deflateBound's conservative estimate
+        if (Strategy != Z_DEFAULT_STRATEGY)
+            return sourceSize + ((sourceSize + 7) >> 3) + ((sourceSize + 63) >> 6) + 5 + 6 + dictionaryId;
+        return compressBound(sourceSize) + dictionaryId;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        // unless reusing, don't init/end in setup/teardown to simulate use of 'compress' method
+        if (ReuseContext)
+            deflateReset(&DeflateStream);
+        else
+            CreateContext(true);
+
+        z_stream& strm = DeflateStream;
+        ByteView dictionary = GetDictionary();
+        if (!dictionary.empty())
+        {
+            int status = deflateSetDictionary(&strm, (Bytef const*)dictionary.data(), dictionary.size());
+            assert(status == Z_OK);
+        }
+
+        strm.avail_in = sourceData.size();
+        strm.next_in = (Bytef*)sourceData.data();
+
+        strm.avail_out = destData.size();
+        strm.next_out = (Bytef*)destData.data();
+
+        int status = deflate(&strm, Z_FINISH);
+        assert(status == Z_STREAM_END && strm.total_out >= 0);
+        destData.resize(strm.total_out);
+
+        if (!ReuseContext)
+            DestroyContext(true);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        // unless reusing, don't init/end in setup/teardown to simulate use of 'decompress' method
+        if (ReuseContext)
+            inflateReset(&InflateStream);
+        else
+            CreateContext(false);
+
+        z_stream& strm = InflateStream;
+        strm.avail_in = sourceData.size();
+        strm.next_in = (Bytef*)sourceData.data();
+
+        strm.avail_out = destData.size();
+        strm.next_out = (Bytef*)destData.data();
+
+        int status = inflate(&strm, Z_FINISH);
+        if (status == Z_NEED_DICT)
+        {
+            // the stream header names the dictionary by its adler32, it's set once asked for
+            ByteView dictionary = GetDictionary();
+            status = inflateSetDictionary(&strm, (Bytef const*)dictionary.data(), dictionary.size());
+            assert(status == Z_OK);
+            status = inflate(&strm, Z_FINISH);
+        }
+        assert(status == Z_STREAM_END && strm.total_out == destData.size());
+
+        if (!ReuseContext)
+            DestroyContext(false);
+    }
+
+    size_t StreamCompressionSize(size_t sourceSize) const override
+    {
+        // room for the empty stored block every sync flush adds
+        return compressBound(sourceSize) + (sourceSize / StreamChunkSize + 1) * 16;
+    }
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        z_stream strm;
+        strm.zalloc = &alloc;
+        strm.zfree = &free;
+        strm.opaque = Z_NULL;
+
+        deflateInit2(&strm, Level, Z_DEFLATED, MAX_WBITS, 8, Strategy);
+        strm.avail_out = destData.size();
+        strm.next_out = (Bytef*)destData.data();
+
+        int status = Z_OK;
+        size_t offset = 0;
+        do
+        {
+            size_t size = min(StreamChunkSize, sourceData.size() - offset);
+            strm.avail_in = size;
+            strm.next_in = (Bytef*)sourceData.data() + offset;
+            offset += size;
+
+            int flush = offset == sourceData.size() ? Z_FINISH : StreamFlush ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+            status = deflate(&strm, flush);
+            assert(status == Z_OK || status == Z_STREAM_END);
+            assert(strm.avail_in == 0);
+        }
+        while (offset < sourceData.size());
+
+        assert(status == Z_STREAM_END);
+        destData.resize(strm.total_out);
+        deflateEnd(&strm);
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        z_stream strm;
+        strm.zalloc = &alloc;
+        strm.zfree = &free;
+        strm.opaque = Z_NULL;
+
+        inflateInit(&strm);
+        strm.avail_out = destData.size();
+        strm.next_out = (Bytef*)destData.data();
+
+        int status = Z_OK;
+        for (size_t offset = 0; offset < sourceData.size() && status != Z_STREAM_END; offset += StreamChunkSize)
+        {
+            strm.avail_in = min(StreamChunkSize, sourceData.size() - offset);
+            strm.next_in = (Bytef*)sourceData.data() + offset;
+
+            status = inflate(&strm, Z_NO_FLUSH);
+            assert(status == Z_OK || status == Z_STREAM_END);
+        }
+        assert(status == Z_STREAM_END && strm.total_out == destData.size());
+        inflateEnd(&strm);
+    }
+
+private:
+    bool const Pooled;
+    int const Level;
+    int const Strategy;
+    mutable BlockPool Pool;
+    mutable z_stream DeflateStream;
+    mutable z_stream InflateStream;
+};
+
+class ZLibPoolTest : public ZLibTest
+{
+public:
+    ZLibPoolTest() : ZLibTest("zlib-pool", false, true) {}
+};
+
+class ZLibReuseTest : public ZLibTest
+{
+public:
+    ZLibReuseTest() : ZLibTest("zlib-reuse", true, false) {}
+};
+
+// Level 1 with Z_FIXED, which the bundled zlib runs as its quick strategy: one hash probe
+// per position and fixed Huffman codes, no trees built.
+class ZLibQuickTest : public ZLibTest
+{
+public:
+    ZLibQuickTest() : ZLibTest("zlib-quick", false, false, 1, Z_FIXED) { AddStreamingPasses(); }
+};
+
+// Starts every call from the preset dictionary, with a fresh stream or a reset one.
+class ZLibDictTest : public ZLibTest
+{
+public:
+    ZLibDictTest(shared_ptr<vector<char> const> dictionary, bool reuse)
+        : ZLibTest(reuse ? "zlib-reuse-dict" : "zlib-dict", reuse, false)
+    {
+        SetDictionary(dictionary);
+    }
+};
+
+#include "ParallelDeflate.h"
+
+// One zlib or gzip stream written by ParallelDeflate on several cores and read back with a
+// single inflate. "zlib-parallel" and "gzip-parallel" are reported against "zlib".
+class ZLibParallelTest : public CompressionTest
+{
+public:
+    ZLibParallelTest(unsigned threads, bool gzip)
+        : CompressionTest(gzip ? "gzip-parallel" : "zlib-parallel")
+        , Deflate(threads, Z_DEFAULT_COMPRESSION, gzip ? ParallelDeflate::Gzip : ParallelDeflate::Zlib)
+    {
+    }
+
+    vector<pair<string, double>> GetPassMetrics(bool compress) const override
+    {
+        vector<pair<string, double>> metrics;
+        if (compress)
+            metrics.push_back(make_pair(string("parallel_threads"), (double)Deflate.GetThreads()));
+        return metrics;
+    }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        return Deflate.Bound(sourceSize);
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        size_t size = Deflate.Compress(sourceData.data(), sourceData.size(), destData.data(), destData.size());
+        assert(size > 0);
+        destData.resize(size);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        // 32 on top of the window bits takes either header
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        int status = inflateInit2(&strm, MAX_WBITS + 32);
+        assert(status == Z_OK);
+
+        strm.avail_in = sourceData.size();
+        strm.next_in = (Bytef*)sourceData.data();
+
+        strm.avail_out = destData.size();
+        strm.next_out = (Bytef*)destData.data();
+
+        status = inflate(&strm, Z_FINISH);
+        assert(status == Z_STREAM_END && strm.total_out == destData.size());
+        inflateEnd(&strm);
+    }
+
+private:
+    mutable ParallelDeflate Deflate;
+};
+
+class ZLibLevelTest : public ZLibTest
+{
+public:
+    ZLibLevelTest(int level, int strategy = Z_DEFAULT_STRATEGY)
+        : ZLibTest(GetName(level, strategy).c_str(), false, false, level, strategy)
+    {
+    }
+
+private:
+    static string GetName(int level, int strategy)
+    {
+        string name = "zlib-" + to_string(level);
+        switch (strategy)
+        {
+        case Z_FILTERED: return name + "-filtered";
+        case Z_HUFFMAN_ONLY: return name + "-huffman";
+        case Z_RLE: return name + "-rle";
+        case Z_FIXED: return name + "-fixed";
+        default: return name;
+        }
+    }
+};
+
+#include "minilzo/minilzo.h"
+
+typedef vector<lzo_align_t, PageAllocator::Allocator<lzo_align_t>> LZOWorkMemory;
+
+class MiniLZOTest : public CompressionTest
+{
+public:
+    MiniLZOTest() : CompressionTest("miniLZO") { AddStreamingPasses(); }
+
+protected:
+    MiniLZOTest(char const* name, bool reuse) : CompressionTest(name, reuse) {}
+
+    // the reuse variant keeps its work memory on the heap instead of the stack
+    bool CreateContext(bool compress) const override
+    {
+        if (!ReuseContext || !compress)
+            return false;
+
+        WorkMemory.resize((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+        return true;
+    }
+    void DestroyContext(bool /*compress*/) const override
+    {
+        WorkMemory = LZOWorkMemory();
+    }
+
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        // taken from testmini.c
+        return sourceSize + sourceSize / 16 + 64 + 3;
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? LZO1X_1_MEM_COMPRESS : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_align_t workMemory[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+        lzo_uint result = destData.size();
+        int status = minilzo1x_1_compress((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, ReuseContext ? WorkMemory.data() : workMemory);
+        assert(status == LZO_E_OK && result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_uint result = destData.size();
+        int status = minilzo1x_decompress((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, NULL);
+        assert(status == LZO_E_OK && result == destData.size());
+    }
+
+    // lzo has no stream, each chunk is compressed on its own
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_align_t workMemory[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+        FrameChunks(sourceData, destData, [&workMemory](char const* source, size_t size, char* dest, size_t capacity)
+        {
+            lzo_uint result = capacity;
+            int status = minilzo1x_1_compress((unsigned char const*)source, size, (unsigned char*)dest, &result, &workMemory);
+            assert(status == LZO_E_OK);
+            return (size_t)result;
+        });
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        UnframeChunks(sourceData, destData, [](char const* source, size_t size, char* dest, size_t destSize)
+        {
+            lzo_uint result = destSize;
+            int status = minilzo1x_decompress((unsigned char const*)source, size, (unsigned char*)dest, &result, NULL);
+            assert(status == LZO_E_OK && result == destSize);
+        });
+    }
+
+private:
+    mutable LZOWorkMemory WorkMemory;
+};
+
+class MiniLZOReuseTest : public MiniLZOTest
+{
+public:
+    MiniLZOReuseTest() : MiniLZOTest("miniLZO-reuse", true) {}
+};
+
+#include "lzo/lzo1c.h"
+
+class LZO1CTest : public CompressionTest
+{
+public:
+    LZO1CTest() : LZO1CTest("LZO1C-3", false)
+    {
+        AddStreamingPasses();
+    }
+
+protected:
+    LZO1CTest(char const* name, bool reuse)
+        : CompressionTest(name, reuse)
+    {
+        static bool init = false;
+        if (!init)
+        {
+            lzo_init();
+            init = true;
+        }
+    }
+
+    // the reuse variant keeps its work memory on the heap instead of the stack
+    bool CreateContext(bool compress) const override
+    {
+        if (!ReuseContext || !compress)
+            return false;
+
+        WorkMemory.resize((LZO1C_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+        return true;
+    }
+    void DestroyContext(bool /*compress*/) const override
+    {
+        WorkMemory = LZOWorkMemory();
+    }
+
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        // taken from testmini.c
+        return sourceSize + sourceSize / 16 + 64 + 3;
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? LZO1C_MEM_COMPRESS : 0;
+    }
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_align_t workMemory[(LZO1C_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+        lzo_uint result = destData.size();
+        int status = lzo1c_3_compress((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, ReuseContext ? WorkMemory.data() : workMemory);
+        assert(status == LZO_E_OK && result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_uint result = destData.size();
+        int status = lzo1c_decompress((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, NULL);
+        assert(status == LZO_E_OK && result == destData.size());
+    }
+
+    void DoStreamCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_align_t workMemory[(LZO1C_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+        FrameChunks(sourceData, destData, [&workMemory](char const* source, size_t size, char* dest, size_t capacity)
+        {
+            lzo_uint result = capacity;
+            int status = lzo1c_3_compress((unsigned char const*)source, size, (unsigned char*)dest, &result, &workMemory);
+            assert(status == LZO_E_OK);
+            return (size_t)result;
+        });
+    }
+
+    void DoStreamDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        UnframeChunks(sourceData, destData, [](char const* source, size_t size, char* dest, size_t destSize)
+        {
+            lzo_uint result = destSize;
+            int status = lzo1c_decompress((unsigned char const*)source, size, (unsigned char*)dest, &result, NULL);
+            assert(status == LZO_E_OK && result == destSize);
+        });
+    }
+
+private:
+    mutable LZOWorkMemory WorkMemory;
+};
+
+class LZO1CReuseTest : public LZO1CTest
+{
+public:
+    LZO1CReuseTest() : LZO1CTest("LZO1C-3-reuse", true) {}
+};
+
+#include "lzo/lzo1x.h"
+
+// One compressor and decompressor pair out of the full LZO library, CreateLZOTests makes
+// these from lzotest's table. The higher levels need more work memory than fits on the
+// stack so it's allocated in setup. With an optimizer the compressed data is rewritten
+// after compressing, which costs compression time to make decompression faster.
+class LZOLevelTest : public CompressionTest
+{
+public:
+    LZOLevelTest(char const* name, lzo_compress_t compress, lzo_decompress_t decompress, size_t workMemorySize, lzo_optimize_t optimize = nullptr)
+        : CompressionTest(name)
+        , CompressFunction(compress)
+        , DecompressFunction(decompress)
+        , OptimizeFunction(optimize)
+        , WorkMemoryBytes(workMemorySize)
+    {
+        static bool init = false;
+        if (!init)
+        {
+            lzo_init();
+            init = true;
+        }
+    }
+
+protected:
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        // lzotest's bound for LZO2A, whose bit flags expand incompressible input more than
+        // the other families, it's big enough for all of them
+        return sourceSize + sourceSize / 8 + 256;
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? WorkMemoryBytes : 0;
+    }
+    void Setup(bool compress) override
+    {
+        if (compress)
+            WorkMemory.resize((WorkMemoryBytes + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+    }
+    void Teardown(bool compress) override
+    {
+        if (compress)
+            WorkMemory = LZOWorkMemory();
+    }
+    lzo_voidp GetWorkMemory() const { return (lzo_voidp)WorkMemory.data(); }
+
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_uint result = destData.size();
+        int status = CompressFunction((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, GetWorkMemory());
+        assert(status == LZO_E_OK && result >= 0);
+
+        // same as lzotest, only blocks that actually compressed are optimized
+        if (OptimizeFunction && result < sourceData.size())
+        {
+            OptimizeScratch.resize(sourceData.size());
+            lzo_uint decompressed = sourceData.size();
+            status = OptimizeFunction((unsigned char*)destData.data(), result, (unsigned char*)OptimizeScratch.data(), &decompressed, nullptr);
+            assert(status == LZO_E_OK && decompressed == sourceData.size());
+        }
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        lzo_uint result = destData.size();
+        int status = DecompressFunction((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result, NULL);
+        assert(status == LZO_E_OK && result == destData.size());
+    }
+
+private:
+    lzo_compress_t const CompressFunction;
+    lzo_decompress_t const DecompressFunction;
+    lzo_optimize_t const OptimizeFunction;
+    size_t const WorkMemoryBytes;
+    LZOWorkMemory WorkMemory;
+    // the optimizer decompresses as it goes
+    mutable CodecBuffer OptimizeScratch;
+};
+
+// LZO1X-999 matching against a preset dictionary, there's only a safe decompressor for it.
+class LZODictTest : public LZOLevelTest
+{
+public:
+    LZODictTest(shared_ptr<vector<char> const> dictionary)
+        : LZOLevelTest("LZO1X-999-safe-dict", nullptr, nullptr, LZO1X_999_MEM_COMPRESS)
+    {
+        SetDictionary(dictionary);
+    }
+
+protected:
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        ByteView dictionary = GetDictionary();
+        lzo_uint result = destData.size();
+        int status = lzo1x_999_compress_dict((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result,
+            GetWorkMemory(), (unsigned char const*)dictionary.data(), dictionary.size());
+        assert(status == LZO_E_OK && result >= 0);
+        destData.resize(result);
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        ByteView dictionary = GetDictionary();
+        lzo_uint result = destData.size();
+        int status = lzo1x_decompress_dict_safe((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)destData.data(), &result,
+            NULL, (unsigned char const*)dictionary.data(), dictionary.size());
+        assert(status == LZO_E_OK && result == destData.size());
+    }
+};
+
+// Every compressor in lzotest's database (lzo/lzotest/db.h), in its order. With variants,
+// each is repeated with the safe, assembler and optimize-pass decompressors it has.
+vector<unique_ptr<CompressionTest>> CreateLZOTests(bool variants);
+
+// Picks a codec for every block from live measurements. The estimator samples each block
+// and sorts it into a class by entropy and repeats, so blocks that look like a PNG don't
+// learn from blocks that look like logs. Every class times each codec on the sample of its
+// first block, and again every RetryInterval blocks so the numbers follow the data. The
+// smallest output whose cost fits the budget wins. A one byte header names the codec the
+// block was written with.
+class AutoTest : public CompressionTest
+{
+public:
+    // budget in nanoseconds of compression per input byte
+    AutoTest(double budget)
+        : CompressionTest("auto")
+        , Budget(budget)
+        , Picks()
+    {
+    }
+
+    vector<pair<string, double>> GetPassMetrics(bool compress) const override
+    {
+        vector<pair<string, double>> metrics;
+        size_t blocks = 0;
+        for (size_t count : Picks)
+            blocks += count;
+        if (!compress || blocks == 0)
+            return metrics;
+
+        // share of the last run's blocks written with each codec
+        for (int codec = 0; codec < CodecCount; ++codec)
+            metrics.push_back(make_pair(string("auto_") + GetName(codec), (double)Picks[codec] / blocks));
+        return metrics;
+    }
+
+protected:
+    enum Codec
+    {
+        Store,
+        LZ4,
+        Snappy,
+        LZO,
+        ZLibFast,
+        ZLibDefault,
+        CodecCount
+    };
+
+    // roughly 2 bits of entropy per class, split by whether the sample repeats itself
+    static int const ClassCount = 8;
+    static size_t const RetryInterval = 64;
+    // weight of the newest trial in the running averages
+    static double constexpr Smoothing = 0.25;
+
+    struct Measurement
+    {
+        bool Tried = false;
+        double Cost = 0;
+        double Ratio = 1;
+    };
+
+    struct BlockClass
+    {
+        size_t Blocks = 0;
+        Measurement Codecs[CodecCount];
+    };
+
+    static char const* GetName(int codec)
+    {
+        static char const* const names[CodecCount] = { "store", "lz4", "snappy", "lzo", "zlib1", "zlib6" };
+        return names[codec];
+    }
+
+    size_t CompressionSize(size_t sourceSize) const override
+    {
+        size_t bound = max<size_t>(compressBound(sourceSize), LZ4_compressBound(sourceSize));
+        bound = max(bound, snappy_max_compressed_length(sourceSize));
+        // taken from testmini.c
+        bound = max(bound, sourceSize + sourceSize / 16 + 64 + 3);
+        return 1 + bound;
+    }
+    size_t WorkMemorySize(bool compress) const override
+    {
+        return compress ? LZO1X_1_MEM_COMPRESS : 0;
+    }
+
+    void Setup(bool compress) override
+    {
+        if (compress)
+        {
+            WorkMemory.resize((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+            InitStream(FastStream, true, Z_BEST_SPEED);
+            InitStream(DefaultStream, true, Z_DEFAULT_COMPRESSION);
+            fill(begin(Picks), end(Picks), 0);
+        }
+        else
+        {
+            InitStream(InflateStream, false, 0);
+        }
+    }
+    void Teardown(bool compress) override
+    {
+        if (compress)
+        {
+            WorkMemory = LZOWorkMemory();
+            TrialBuffer = CodecBuffer();
+            deflateEnd(&FastStream);
+            deflateEnd(&DefaultStream);
+        }
+        else
+        {
+            inflateEnd(&InflateStream);
+        }
+    }
+
+    void DoCompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        char sample[CompressibilityEstimator::SampleSize];
+        size_t sampleSize = CompressibilityEstimator::TakeSample(sourceData.data(), sourceData.size(), sample);
+        BlockClass& blockClass = Classes[GetClass(CompressibilityEstimator::Measure(sample, sampleSize))];
+
+        if (blockClass.Blocks++ % RetryInterval == 0 && sampleSize > 0)
+            TimeCodecs(blockClass, ByteView(sample, sampleSize));
+
+        int codec = Pick(blockClass);
+        size_t size = Compress(codec, sourceData, destData.data() + 1, destData.size() - 1);
+
+        // whatever was picked, a block that didn't shrink is kept as is
+        if (size >= sourceData.size() && codec != Store)
+        {
+            codec = Store;
+            size = Compress(Store, sourceData, destData.data() + 1, destData.size() - 1);
+        }
+
+        destData[0] = (char)codec;
+        destData.resize(1 + size);
+        ++Picks[codec];
+    }
+
+    void DoDecompress(ByteView sourceData, CodecBuffer& destData) const override
+    {
+        assert(!sourceData.empty());
+        char const* source = sourceData.data() + 1;
+        size_t sourceSize = sourceData.size() - 1;
+
+        switch (sourceData.data()[0])
+        {
+        case Store:
+        {
+            assert(sourceSize == destData.size());
+            memcpy(destData.data(), source, sourceSize);
+            break;
+        }
+        case LZ4:
+        {
+            int result = LZ4_decompress_safe(source, destData.data(), sourceSize, destData.size());
+            assert(result >= 0 && result == (int)destData.size());
+            break;
+        }
+        case Snappy:
+        {
+            size_t result = destData.size();
+            snappy_status status = snappy_uncompress(source, sourceSize, destData.data(), &result);
+            assert(status == SNAPPY_OK && result == destData.size());
+            break;
+        }
+        case LZO:
+        {
+            lzo_uint result = destData.size();
+            int status = minilzo1x_decompress((unsigned char const*)source, sourceSize, (unsigned char*)destData.data(), &result, NULL);
+            assert(status == LZO_E_OK && result == destData.size());
+            break;
+        }
+        case ZLibFast:
+        case ZLibDefault:
+        {
+            // both levels share a format
+            inflateReset(&InflateStream);
+            InflateStream.avail_in = sourceSize;
+            InflateStream.next_in = (Bytef*)source;
+            InflateStream.avail_out = destData.size();
+            InflateStream.next_out = (Bytef*)destData.data();
+            int status = inflate(&InflateStream, Z_FINISH);
+            assert(status == Z_STREAM_END && InflateStream.total_out == destData.size());
+            break;
+        }
+        default:
+            assert(false);
+        }
+    }
+
+private:
+    static int GetClass(CompressibilityEstimator::Estimate const& estimate)
+    {
+        int entropyClass = min(3, (int)(estimate.Entropy / 2));
+        return entropyClass * 2 + (estimate.MatchFraction > 0.25 ? 1 : 0);
+    }
+
+    // times every codec on the sample, the cost of doing so lands on the block being compressed
+    void TimeCodecs(BlockClass& blockClass, ByteView sample) const
+    {
+        TrialBuffer.resize(CompressionSize(sample.size()));
+        for (int codec = Store + 1; codec < CodecCount; ++codec)
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            size_t size = Compress(codec, sample, TrialBuffer.data(), TrialBuffer.size());
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            Measurement& measurement = blockClass.Codecs[codec];
+            double cost = seconds * 1e9 / sample.size();
+            double ratio = (double)size / sample.size();
+            measurement.Cost = measurement.Tried ? measurement.Cost + (cost - measurement.Cost) * Smoothing : cost;
+            measurement.Ratio = measurement.Tried ? measurement.Ratio + (ratio - measurement.Ratio) * Smoothing : ratio;
+            measurement.Tried = true;
+        }
+    }
+
+    int Pick(BlockClass const& blockClass) const
+    {
+        // storing costs nothing and keeps the size, anything else has to beat it
+        int best = Store;
+        double bestRatio = 1;
+        for (int codec = Store + 1; codec < CodecCount; ++codec)
+        {
+            Measurement const& measurement = blockClass.Codecs[codec];
+            if (measurement.Tried && measurement.Cost <= Budget && measurement.Ratio < bestRatio)
+            {
+                best = codec;
+                bestRatio = measurement.Ratio;
+            }
+        }
+        return best;
+    }
+
+    size_t Compress(int codec, ByteView sourceData, char* dest, size_t capacity) const
+    {
+        switch (codec)
+        {
+        case LZ4:
+        {
+            int result = LZ4_compress_default(sourceData.data(), dest, sourceData.size(), capacity);
+            assert(result > 0);
+            return result;
+        }
+        case Snappy:
+        {
+            size_t result = capacity;
+            snappy_status status = snappy_compress(sourceData.data(), sourceData.size(), dest, &result);
+            assert(status == SNAPPY_OK);
+            return result;
+        }
+        case LZO:
+        {
+            lzo_uint result = capacity;
+            int status = minilzo1x_1_compress((unsigned char const*)sourceData.data(), sourceData.size(), (unsigned char*)dest, &result, WorkMemory.data());
+            assert(status == LZO_E_OK);
+            return result;
+        }
+        case ZLibFast:
+        case ZLibDefault:
+        {
+            z_stream& strm = codec == ZLibFast ? FastStream : DefaultStream;
+            deflateReset(&strm);
+            strm.avail_in = sourceData.size();
+            strm.next_in = (Bytef*)sourceData.data();
+            strm.avail_out = capacity;
+            strm.next_out = (Bytef*)dest;
+            int status = deflate(&strm, Z_FINISH);
+            assert(status == Z_STREAM_END);
+            return strm.total_out;
+        }
+        default:
+            assert(codec == Store && capacity >= sourceData.size());
+            memcpy(dest, sourceData.data(), sourceData.size());
+            return sourceData.size();
+        }
+    }
+
+    static void InitStream(z_stream& strm, bool compress, int level)
+    {
+        strm.zalloc = [](voidpf, uInt items, uInt size) -> voidpf { return PageAllocator::Allocate(items * size); };
+        strm.zfree = [](voidpf, voidpf address) { PageAllocator::Free(address); };
+        strm.opaque = Z_NULL;
+
+        int status = compress ? deflateInit(&strm, level) : inflateInit(&strm);
+        assert(status == Z_OK);
+    }
+
+    double const Budget;
+    // measurements carry over between passes, like a long running service would keep them
+    mutable BlockClass Classes[ClassCount];
+    mutable size_t Picks[CodecCount];
+    mutable CodecBuffer TrialBuffer;
+    mutable LZOWorkMemory WorkMemory;
+    mutable z_stream FastStream;
+    mutable z_stream DefaultStream;
+    mutable z_stream InflateStream;
+};
+
+// Every codec the harness knows about, in the order they are reported.
+inline vector<unique_ptr<CompressionTest>> CreateCompressionTests()
+{
+    vector<unique_ptr<CompressionTest>> tests;
+    tests.push_back(unique_ptr<CompressionTest>(new LZ4Test()));
+    tests.push_back(unique_ptr<CompressionTest>(new LZ4ReuseTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new LZ4FastTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new SnappyTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibPoolTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibReuseTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibQuickTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new MiniLZOTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new MiniLZOReuseTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new LZO1CTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new LZO1CReuseTest()));
+    return tests;
+}
+
+// Each codec across its levels, for picking an operating point off the ratio/speed curve.
+inline vector<unique_ptr<CompressionTest>> CreateLevelSweepTests()
+{
+    vector<unique_ptr<CompressionTest>> tests;
+
+    for (int level = 1; level <= 9; ++level)
+        tests.push_back(unique_ptr<CompressionTest>(new ZLibLevelTest(level)));
+    for (int strategy : { Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED })
+        tests.push_back(unique_ptr<CompressionTest>(new ZLibLevelTest(6, strategy)));
+
+    for (int acceleration : { 1, 2, 4, 8, 16, 32, 64 })
+        tests.push_back(unique_ptr<CompressionTest>(new LZ4AccelerationTest(acceleration)));
+    for (int level = 1; level <= 12; ++level)
+        tests.push_back(unique_ptr<CompressionTest>(new LZ4HCTest(level)));
+
+    for (auto& test : CreateLZOTests(false))
+        tests.push_back(move(test));
+
+    return tests;
+}
+
+// Codecs that take a preset dictionary, each next to the same codec without one: "x-dict"
+// is reported against "x".
+inline vector<unique_ptr<CompressionTest>> CreateDictionaryTests(shared_ptr<vector<char> const> dictionary)
+{
+    vector<unique_ptr<CompressionTest>> tests;
+    tests.push_back(unique_ptr<CompressionTest>(new LZ4Test()));
+    tests.push_back(unique_ptr<CompressionTest>(new LZ4DictTest(dictionary)));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibDictTest(dictionary, false)));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibReuseTest()));
+    tests.push_back(unique_ptr<CompressionTest>(new ZLibDictTest(dictionary, true)));
+    tests.push_back(unique_ptr<CompressionTest>(new LZOLevelTest("LZO1X-999-safe", lzo1x_999_compress, lzo1x_decompress_safe, LZO1X_999_MEM_COMPRESS)));
+    tests.push_back(unique_ptr<CompressionTest>(new LZODictTest(dictionary)));
+    return tests;
+}
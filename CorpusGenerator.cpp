@@ -0,0 +1,337 @@
+#include "CorpusGenerator.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// splitmix64, used instead of <random> because the standard distributions aren't
+// guaranteed to produce the same numbers on every standard library
+class CorpusGenerator::Random
+{
+public:
+    Random(uint64_t seed, double variety)
+        : State(seed)
+        , Variety(variety)
+    {
+    }
+
+    uint64_t Next()
+    {
+        uint64_t z = (State += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+    uint32_t Below(uint32_t count) { return (uint32_t)(((Next() >> 32) * count) >> 32); }
+    bool Chance(double probability) { return Unit() < probability; }
+
+    // Picks from the first part of a list, favouring the front. Low variety uses fewer
+    // entries and a steeper skew, like real logs where a few values dominate.
+    template <size_t N>
+    char const* Pick(char const* const (&values)[N])
+    {
+        uint32_t used = (uint32_t)max(2.0, ceil(N * Variety));
+        double skew = 1.0 + 3.0 * (1.0 - Variety);
+        return values[min((uint32_t)(pow(Unit(), skew) * used), used - 1)];
+    }
+
+    // Roughly centred on base, spread grows with variety.
+    int64_t Around(int64_t base, int64_t spread)
+    {
+        int64_t range = max<int64_t>(1, (int64_t)(spread * Variety));
+        return base + (int64_t)(Next() % (uint64_t)(2 * range + 1)) - range;
+    }
+
+private:
+    uint64_t State;
+    double Variety;
+};
+
+namespace
+{
+    char const* const Services[] = { "checkout", "search", "auth", "inventory", "payments", "gateway", "profile", "shipping", "recommendations", "notifications", "billing", "catalog" };
+    char const* const Levels[] = { "INFO", "DEBUG", "WARN", "ERROR", "TRACE" };
+    char const* const Paths[] = { "/api/v1/orders", "/api/v1/cart", "/api/v2/search", "/login", "/api/v1/users/me", "/health", "/api/v1/items", "/static/app.js", "/api/v1/payments", "/metrics", "/api/v2/recommend", "/logout" };
+    char const* const Messages[] = { "request completed", "cache miss", "retrying upstream call", "user not found", "token refreshed", "slow query", "connection reset by peer", "payload too large", "rate limited", "circuit breaker open" };
+    char const* const Names[] = { "Alice", "Bob", "Carol", "Dave", "Erin", "Frank", "Grace", "Heidi", "Ivan", "Judy", "Mallory", "Niaj", "Olivia", "Peggy", "Rupert", "Sybil", "Trent", "Victor", "Walter", "Yolanda" };
+    char const* const Countries[] = { "US", "DE", "GB", "FR", "JP", "CA", "BR", "IN", "AU", "NL", "SE", "KR", "MX", "ES", "IT" };
+    char const* const Products[] = { "widget", "gadget", "sprocket", "gizmo", "doohickey", "thingamajig", "whatsit", "contraption", "device", "apparatus" };
+    char const* const Statuses[] = { "shipped", "pending", "delivered", "cancelled", "returned", "processing" };
+    char const* const Types[] = { "int", "size_t", "char const*", "bool", "uint32_t", "double", "void*", "Buffer&" };
+    char const* const Identifiers[] = { "count", "index", "buffer", "length", "result", "offset", "source", "dest", "value", "state", "header", "table", "entry", "node", "block", "flags" };
+    char const* const Verbs[] = { "read", "write", "find", "update", "create", "parse", "encode", "decode", "reset", "flush", "insert", "remove" };
+
+    void Append(string& out, char const* format, ...)
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        out.append(buffer, (size_t)min(written, (int)sizeof(buffer) - 1));
+    }
+
+    void AppendVarint(string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += (char)(value | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    // little endian regardless of the host
+    void AppendFixed64(string& out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out += (char)(value >> (8 * i));
+    }
+
+    uint64_t HashName(char const* name)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (; *name; ++name)
+            hash = (hash ^ (unsigned char)*name) * 1099511628211ull;
+        return hash;
+    }
+}
+
+CorpusGenerator::CorpusGenerator(Options const& options)
+    : Settings(options)
+{
+}
+
+vector<char const*> CorpusGenerator::GetDatasetNames()
+{
+    return { "gen-json", "gen-csv", "gen-source", "gen-records", "gen-sparse", "gen-random", "gen-templates" };
+}
+
+vector<string> CorpusGenerator::Generate(string const& dir) const
+{
+    Platform::MakeDirectory(dir.c_str());
+
+    vector<string> paths;
+    for (char const* name : GetDatasetNames())
+    {
+        string path = dir + "/" + name;
+        vector<char> data = Generate(name);
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            fprintf(stderr, "couldn't write %s\n", path.c_str());
+            continue;
+        }
+
+        size_t written = fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+
+        if (written == data.size())
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+vector<char> CorpusGenerator::Generate(char const* dataset) const
+{
+    typedef void (CorpusGenerator::*Generator)(Random&, string&) const;
+    static Generator const Generators[] =
+    {
+        &CorpusGenerator::JsonLogs,
+        &CorpusGenerator::CsvRows,
+        &CorpusGenerator::SourceText,
+        &CorpusGenerator::BinaryRecords,
+        &CorpusGenerator::SparseZeros,
+        &CorpusGenerator::RandomBytes,
+        &CorpusGenerator::Templates,
+    };
+
+    vector<char const*> names = GetDatasetNames();
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        if (strcmp(names[i], dataset) != 0)
+            continue;
+
+        Random random(Settings.Seed ^ HashName(dataset), Settings.Variety);
+
+        string out;
+        out.reserve(Settings.Size + 1024);
+        while (out.size() < Settings.Size)
+            (this->*Generators[i])(random, out);
+
+        return vector<char>(out.begin(), out.begin() + Settings.Size);
+    }
+    return vector<char>();
+}
+
+// Random values are always drawn into locals first, function arguments are evaluated in a
+// different order by different compilers and the output has to match everywhere.
+
+void CorpusGenerator::JsonLogs(Random& random, string& out) const
+{
+    // one structured log line per call, lines are long enough that the timestamp only moves forward
+    unsigned long long time = 1790000000000ull + out.size() / 8 + random.Below(8);
+    char const* level = random.Pick(Levels);
+    char const* service = random.Pick(Services);
+    unsigned host = random.Below(1 + (uint32_t)(32 * Settings.Variety));
+    long long user = (long long)random.Around(500000, 400000);
+    char const* path = random.Pick(Paths);
+    unsigned status = random.Chance(0.9) ? 200 : 500 + random.Below(4);
+    double latency = random.Around(40, 35) + random.Unit();
+    char const* message = random.Pick(Messages);
+
+    Append(out, "{\"ts\":%llu,\"level\":\"%s\",\"service\":\"%s\",\"host\":\"web-%02u\",\"user_id\":%lld,"
+        "\"path\":\"%s\",\"status\":%u,\"latency_ms\":%.1f,\"msg\":\"%s\"}\n",
+        time, level, service, host, user, path, status, latency, message);
+}
+
+void CorpusGenerator::CsvRows(Random& random, string& out) const
+{
+    if (out.empty())
+        out += "id,date,customer,country,product,quantity,unit_price,status\n";
+
+    // rows are always longer than 32 bytes so ids keep increasing
+    unsigned long long id = 100000 + out.size() / 32;
+    unsigned month = 1 + random.Below(12);
+    unsigned day = 1 + random.Below(28);
+    char const* first = random.Pick(Names);
+    char const* last = random.Pick(Names);
+    char const* country = random.Pick(Countries);
+    char const* product = random.Pick(Products);
+    unsigned quantity = 1 + random.Below(1 + (uint32_t)(20 * Settings.Variety));
+    double price = random.Around(2500, 2400) / 100.0;
+    char const* status = random.Pick(Statuses);
+
+    Append(out, "%llu,2026-%02u-%02u,%s %s,%s,%s,%u,%.2f,%s\n", id, month, day, first, last, country, product, quantity, price, status);
+}
+
+void CorpusGenerator::SourceText(Random& random, string& out) const
+{
+    // a small C-like function
+    char const* returnType = random.Pick(Types);
+    char const* verb = random.Pick(Verbs);
+    char const* noun = random.Pick(Identifiers);
+    char const* firstType = random.Pick(Types);
+    char const* firstName = random.Pick(Identifiers);
+    char const* secondType = random.Pick(Types);
+    char const* secondName = random.Pick(Identifiers);
+
+    Append(out, "static %s %s_%s(%s %s, %s %s)\n{\n", returnType, verb, noun, firstType, firstName, secondType, secondName);
+
+    uint32_t statements = 2 + random.Below(6);
+    for (uint32_t i = 0; i < statements; ++i)
+    {
+        uint32_t kind = random.Below(4);
+        char const* a = random.Pick(Identifiers);
+        char const* b = random.Pick(Identifiers);
+        char const* c = random.Pick(Identifiers);
+        char const* action = random.Pick(Verbs);
+        long long amount = (long long)random.Around(16, 16);
+
+        switch (kind)
+        {
+        case 0:
+            Append(out, "    if (%s == nullptr)\n        return %s;\n\n", a, b);
+            break;
+        case 1:
+            Append(out, "    for (size_t i = 0; i < %s; ++i)\n        %s[i] = %s_%s(%s[i]);\n\n", a, b, action, c, b);
+            break;
+        case 2:
+            Append(out, "    %s += %lld;\n", a, amount);
+            break;
+        default:
+            Append(out, "    // %s the %s before the %s\n    %s_%s(%s, %s);\n", action, a, b, action, a, b, c);
+            break;
+        }
+    }
+
+    char const* result = random.Pick(Identifiers);
+    Append(out, "    return %s;\n}\n\n", result);
+}
+
+void CorpusGenerator::BinaryRecords(Random& random, string& out) const
+{
+    // protobuf style: length prefixed records of tagged varint, string and fixed64 fields
+    string record;
+
+    AppendVarint(record, (1 << 3) | 0);
+    AppendVarint(record, (uint64_t)random.Around(1 << 20, 1 << 19));
+
+    char const* name = random.Pick(Names);
+    AppendVarint(record, (2 << 3) | 2);
+    AppendVarint(record, strlen(name));
+    record += name;
+
+    AppendVarint(record, (3 << 3) | 0);
+    AppendVarint(record, random.Below(1 + (uint32_t)(1000 * Settings.Variety)));
+
+    double amount = random.Around(10000, 9000) / 100.0;
+    uint64_t amountBits;
+    memcpy(&amountBits, &amount, sizeof(amountBits));
+    AppendVarint(record, (4 << 3) | 1);
+    AppendFixed64(record, amountBits);
+
+    char const* country = random.Pick(Countries);
+    AppendVarint(record, (5 << 3) | 2);
+    AppendVarint(record, strlen(country));
+    record += country;
+
+    AppendVarint(out, record.size());
+    out += record;
+}
+
+void CorpusGenerator::SparseZeros(Random& random, string& out) const
+{
+    // runs of zeros broken up by short bursts of data, density grows with variety
+    size_t zeros = 16 + random.Below((uint32_t)(4096 * (1.0 - Settings.Variety)) + 1);
+    out.append(zeros, '\0');
+
+    uint32_t burst = 1 + random.Below(16);
+    for (uint32_t i = 0; i < burst; ++i)
+        out += (char)random.Next();
+}
+
+void CorpusGenerator::RandomBytes(Random& random, string& out) const
+{
+    AppendFixed64(out, random.Next());
+}
+
+void CorpusGenerator::Templates(Random& random, string& out) const
+{
+    // the same few message bodies over and over with only the fields changing
+    uint32_t body = random.Below(1 + (uint32_t)(3 * Settings.Variety));
+    unsigned id = random.Below(1000000);
+    char const* name = random.Pick(Names);
+    char const* status = random.Pick(Statuses);
+    char const* country = random.Pick(Countries);
+    unsigned dollars = random.Below(500);
+    unsigned cents = random.Below(100);
+    unsigned days = 1 + random.Below(9);
+
+    switch (body)
+    {
+    case 0:
+        Append(out, "<event type=\"order\"><id>%u</id><customer>%s</customer><total>%u.%02u</total><status>%s</status></event>\n",
+            id, name, dollars, cents, status);
+        break;
+    case 1:
+        Append(out, "Dear %s, your order #%u has been %s. Estimated delivery: %u days. Thank you for shopping with us!\n",
+            name, id, status, days);
+        break;
+    case 2:
+        Append(out, "INSERT INTO orders (id, customer, total, status) VALUES (%u, '%s', %u.%02u, '%s');\n",
+            id, name, dollars, cents, status);
+        break;
+    default:
+        Append(out, "[%u] %s logged in from %s, session expires in %u minutes\n", id, name, country, 5 + days * 6);
+        break;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes reproducible synthetic datasets so the codecs can be compared across very
+// different levels of compressibility, not just on already compressed images.
+// Output only depends on the options, the same seed gives the same bytes on every platform.
+class CorpusGenerator
+{
+public:
+    struct Options
+    {
+        size_t Size = 1024 * 1024;
+        uint64_t Seed = 1;
+        // 0 gives small vocabularies and heavily repeated values, 1 gives wide
+        // vocabularies and noisier numbers. Random bytes ignore it.
+        double Variety = 0.5;
+    };
+
+    CorpusGenerator(Options const& options);
+
+    // Writes one file per dataset into dir and returns their paths.
+    std::vector<std::string> Generate(std::string const& dir) const;
+
+    static std::vector<char const*> GetDatasetNames();
+    std::vector<char> Generate(char const* dataset) const;
+
+private:
+    class Random;
+
+    void JsonLogs(Random& random, std::string& out) const;
+    void CsvRows(Random& random, std::string& out) const;
+    void SourceText(Random& random, std::string& out) const;
+    void BinaryRecords(Random& random, std::string& out) const;
+    void SparseZeros(Random& random, std::string& out) const;
+    void RandomBytes(Random& random, std::string& out) const;
+    void Templates(Random& random, std::string& out) const;
+
+    Options Settings;
+};
@@ -0,0 +1,131 @@
+#include "DictionaryTrainer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    size_t const SampleFactor = 100;
+    size_t const KmerSize = 8;
+    size_t const SegmentSize = 64;
+    int const TableBits = 20;
+
+    struct Segment
+    {
+        size_t Offset;
+        uint64_t Score;
+    };
+
+    // collisions only blur the counts a little, the table stays in cache at 4MB
+    uint32_t HashKmer(char const* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return (uint32_t)((value * 0x9E3779B97F4A7C15ull) >> (64 - TableBits));
+    }
+
+    // a substring seen once can't be matched by any other record
+    uint64_t KmerScore(std::vector<uint32_t> const& counts, uint32_t hash)
+    {
+        return counts[hash] > 1 ? counts[hash] - 1 : 0;
+    }
+
+    void ReadPrefix(std::string const& path, size_t size, std::vector<char>& sample)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            fprintf(stderr, "warning: couldn't open %s\n", path.c_str());
+            return;
+        }
+
+        size_t start = sample.size();
+        sample.resize(start + size);
+        sample.resize(start + fread(sample.data() + start, 1, size, file));
+        fclose(file);
+    }
+}
+
+std::vector<char> DictionaryTrainer::Train(std::vector<std::string> const& files, size_t size)
+{
+    std::vector<char> sample;
+    if (files.empty() || size == 0)
+        return sample;
+
+    size_t share = std::max(size * SampleFactor / files.size(), SegmentSize);
+    for (std::string const& path : files)
+        ReadPrefix(path, share, sample);
+
+    if (sample.size() <= size)
+        return sample;
+
+    std::vector<uint32_t> counts((size_t)1 << TableBits);
+    std::vector<uint32_t> hashes(sample.size() - KmerSize + 1);
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        hashes[i] = HashKmer(sample.data() + i);
+        ++counts[hashes[i]];
+    }
+
+    // one segment out of every epoch, so the dictionary covers the whole sample instead of
+    // piling up copies of whatever is most common
+    size_t const segmentCount = std::max<size_t>(size / SegmentSize, 1);
+    size_t const epochSize = std::max(sample.size() / segmentCount, SegmentSize);
+    size_t const windowKmers = SegmentSize - KmerSize + 1;
+
+    std::vector<Segment> segments;
+    for (size_t epoch = 0; epoch + SegmentSize <= sample.size(); epoch += epochSize)
+    {
+        size_t last = std::min(epoch + epochSize, sample.size()) - SegmentSize;
+
+        uint64_t score = 0;
+        for (size_t i = 0; i < windowKmers; ++i)
+            score += KmerScore(counts, hashes[epoch + i]);
+
+        Segment best = { epoch, score };
+        for (size_t offset = epoch + 1; offset <= last; ++offset)
+        {
+            score += KmerScore(counts, hashes[offset + windowKmers - 1]);
+            score -= KmerScore(counts, hashes[offset - 1]);
+            if (score > best.Score)
+                best = Segment{ offset, score };
+        }
+
+        if (best.Score == 0)
+            continue;
+
+        // what's in the dictionary already shouldn't make a second segment look good
+        for (size_t i = 0; i < windowKmers; ++i)
+            counts[hashes[best.Offset + i]] = 0;
+        segments.push_back(best);
+    }
+
+    std::stable_sort(segments.begin(), segments.end(), [](Segment const& a, Segment const& b) { return a.Score < b.Score; });
+    if (segments.size() > segmentCount)
+        segments.erase(segments.begin(), segments.end() - segmentCount);
+
+    std::vector<char> dictionary;
+    dictionary.reserve(segments.size() * SegmentSize);
+    for (Segment const& segment : segments)
+        dictionary.insert(dictionary.end(), sample.begin() + segment.Offset, sample.begin() + segment.Offset + SegmentSize);
+    return dictionary;
+}
+
+bool DictionaryTrainer::Load(std::string const& path, std::vector<char>& dictionary)
+{
+    dictionary.clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        dictionary.insert(dictionary.end(), buffer, buffer + read);
+
+    bool valid = !ferror(file) && !dictionary.empty();
+    fclose(file);
+    return valid;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Builds the preset dictionary the "-dict" codec variants start from. Small records only
+// compress well against content they share with others, so the dictionary is made of the
+// sample segments whose 8 byte substrings occur most often across the sample, a cut down
+// version of zstd's COVER trainer. The strongest segments go last, closest to the data,
+// where matches cost the shortest offsets.
+class DictionaryTrainer
+{
+public:
+    // Reads the start of every file, sharing a sample of 100x size bytes between them.
+    // Returns the whole sample if it's no bigger than size, empty if nothing could be read.
+    static std::vector<char> Train(std::vector<std::string> const& files, size_t size);
+
+    // A dictionary trained elsewhere (zstd --train, a hand made one) used as is.
+    static bool Load(std::string const& path, std::vector<char>& dictionary);
+};
@@ -0,0 +1,138 @@
+#include "CompressionTests.h"
+
+#include "lzo/lzo1.h"
+#include "lzo/lzo1a.h"
+#include "lzo/lzo1b.h"
+#include "lzo/lzo1c.h"
+#include "lzo/lzo1f.h"
+#include "lzo/lzo1x.h"
+#include "lzo/lzo1y.h"
+#include "lzo/lzo1z.h"
+#include "lzo/lzo2a.h"
+
+// lzotest's database is included as is, so it needs the same surroundings lzotest.c gives it:
+// the family switches, method ids, assembler prototypes and level wrappers.
+#define HAVE_LZO1_H 1
+#define HAVE_LZO1A_H 1
+#define HAVE_LZO1B_H 1
+#define HAVE_LZO1C_H 1
+#define HAVE_LZO1F_H 1
+#define HAVE_LZO1X_H 1
+#define HAVE_LZO1Y_H 1
+#define HAVE_LZO1Z_H 1
+#define HAVE_LZO2A_H 1
+
+// same values as lzotest.c
+enum
+{
+    M_LZO1B_1 = 1,
+    M_LZO1B_2, M_LZO1B_3, M_LZO1B_4, M_LZO1B_5,
+    M_LZO1B_6, M_LZO1B_7, M_LZO1B_8, M_LZO1B_9,
+
+    M_LZO1C_1 = 11,
+    M_LZO1C_2, M_LZO1C_3, M_LZO1C_4, M_LZO1C_5,
+    M_LZO1C_6, M_LZO1C_7, M_LZO1C_8, M_LZO1C_9,
+
+    M_LZO1 = 21,
+    M_LZO1A = 31,
+
+    M_LZO1B_99 = 901,
+    M_LZO1B_999 = 902,
+    M_LZO1C_99 = 911,
+    M_LZO1C_999 = 912,
+    M_LZO1_99 = 921,
+    M_LZO1A_99 = 931,
+
+    M_LZO1F_1 = 61,
+    M_LZO1F_999 = 962,
+    M_LZO1X_1 = 71,
+    M_LZO1X_1_11 = 111,
+    M_LZO1X_1_12 = 112,
+    M_LZO1X_1_15 = 115,
+    M_LZO1X_999 = 972,
+    M_LZO1Y_1 = 81,
+    M_LZO1Y_999 = 982,
+    M_LZO1Z_999 = 992,
+
+    M_LZO2A_999 = 942,
+
+    M_LAST_LZO_COMPRESSOR = 998,
+
+    M_MEMCPY = 999,
+    M_MEMSET = 5001,
+    M_ADLER32 = 6001,
+    M_CRC32 = 6002,
+};
+
+// the 999 level wrappers pass lzotest's preset dictionary, there's none here
+static struct
+{
+    lzo_bytep ptr;
+    lzo_uint len;
+} dict = { nullptr, 0 };
+
+#include "lzo/lzotest/asm.h"
+#include "lzo/lzotest/wrap.h"
+
+namespace
+{
+    // lzotest.c's compress_t
+    struct LZOMethod
+    {
+        char const* Name;
+        int Id;
+        lzo_uint32_t CompressMemory;
+        lzo_uint32_t DecompressMemory;
+        lzo_compress_t Compress;
+        lzo_optimize_t Optimize;
+        lzo_decompress_t Decompress;
+        lzo_decompress_t DecompressSafe;
+        lzo_decompress_t DecompressAsm;
+        lzo_decompress_t DecompressAsmSafe;
+        lzo_decompress_t DecompressAsmFast;
+        lzo_decompress_t DecompressAsmFastSafe;
+        lzo_compress_dict_t CompressDict;
+        lzo_decompress_dict_t DecompressDictSafe;
+    };
+
+    LZOMethod const Methods[] =
+    {
+#include "lzo/lzotest/db.h"
+    };
+}
+
+vector<unique_ptr<CompressionTest>> CreateLZOTests(bool variants)
+{
+    vector<unique_ptr<CompressionTest>> tests;
+
+    for (LZOMethod const& method : Methods)
+    {
+        // the memcpy and checksum rows are lzotest's baselines, not codecs
+        if (method.Id == M_MEMCPY || method.Id == M_MEMSET || method.Id == M_ADLER32 || method.Id == M_CRC32)
+            continue;
+
+        tests.push_back(unique_ptr<CompressionTest>(new LZOLevelTest(method.Name, method.Compress, method.Decompress, method.CompressMemory)));
+        if (!variants)
+            continue;
+
+        // the assembler ones are only there when the library was built with LZO_USE_ASM
+        pair<char const*, lzo_decompress_t> const decompressors[] =
+        {
+            make_pair("-safe", method.DecompressSafe),
+            make_pair("-asm", method.DecompressAsm),
+            make_pair("-asm-safe", method.DecompressAsmSafe),
+            make_pair("-asm-fast", method.DecompressAsmFast),
+            make_pair("-asm-fast-safe", method.DecompressAsmFastSafe),
+        };
+        for (auto const& decompressor : decompressors)
+        {
+            if (decompressor.second)
+                tests.push_back(unique_ptr<CompressionTest>(new LZOLevelTest((method.Name + string(decompressor.first)).c_str(), method.Compress, decompressor.second, method.CompressMemory)));
+        }
+
+        if (method.Optimize)
+            tests.push_back(unique_ptr<CompressionTest>(new LZOLevelTest((method.Name + string("-opt")).c_str(), method.Compress, method.Decompress, method.CompressMemory, method.Optimize)));
+    }
+
+    return tests;
+}
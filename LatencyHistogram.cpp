@@ -0,0 +1,59 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram()
+    : Counts(SubBucketCount + (64 - SubBucketBits) * HalfCount)
+    , Count(0)
+    , Max(0)
+{
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds)
+{
+    ++Counts[GetIndex(nanoseconds)];
+    ++Count;
+    Max = std::max(Max, nanoseconds);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const
+{
+    if (Count == 0)
+        return 0;
+    if (fraction >= 1)
+        return Max;
+
+    // the call at this rank (1 based) sets the percentile
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(fraction * Count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Counts.size(); ++i)
+    {
+        seen += Counts[i];
+        if (seen >= rank)
+            return std::min(GetUpperValue(i), Max);
+    }
+    return Max;
+}
+
+size_t LatencyHistogram::GetIndex(uint64_t value)
+{
+    if (value < SubBucketCount)
+        return (size_t)value;
+
+    // shift so the value keeps SubBucketBits significant bits, its top bit is always set
+    int shift = 0;
+    while ((value >> shift) >= SubBucketCount)
+        ++shift;
+
+    return (size_t)(SubBucketCount + (shift - 1) * HalfCount + ((value >> shift) - HalfCount));
+}
+
+uint64_t LatencyHistogram::GetUpperValue(size_t index)
+{
+    if (index < SubBucketCount)
+        return index;
+
+    uint64_t shift = (index - SubBucketCount) / HalfCount + 1;
+    uint64_t sub = (index - SubBucketCount) % HalfCount + HalfCount;
+    return ((sub + 1) << shift) - 1;
+}
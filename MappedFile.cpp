@@ -0,0 +1,125 @@
+#include "MappedFile.h"
+#include "Platform.h"
+
+#include <chrono>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(char const* path, Options const& options)
+    : Data(nullptr)
+    , Size(0)
+    , Valid(false)
+    , PrefaultSeconds(0)
+#if defined(_WIN32)
+    , File(INVALID_HANDLE_VALUE)
+    , Mapping(nullptr)
+#endif
+{
+#if defined(_WIN32)
+    // windows has no per mapping advice, the flag on the file handle is the closest thing
+    DWORD flags = options.Access == Random ? FILE_FLAG_RANDOM_ACCESS : options.Access == Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(File, &size))
+        return;
+    Size = (size_t)size.QuadPart;
+
+    // empty files can't be mapped but are still valid input
+    if (Size > 0)
+    {
+        Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!Mapping)
+            return;
+
+        Data = (char const*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!Data)
+            return;
+    }
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return;
+
+    struct stat status;
+    bool opened = fstat(file, &status) == 0;
+    Size = opened ? (size_t)status.st_size : 0;
+
+    // empty files can't be mapped but are still valid input
+    if (opened && Size > 0)
+    {
+        void* data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, file, 0);
+        Data = data == MAP_FAILED ? nullptr : (char const*)data;
+    }
+    close(file);
+
+    if (!opened || (Size > 0 && !Data))
+        return;
+
+    if (Data)
+    {
+        static int const advice[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+        madvise((void*)Data, Size, advice[options.Access]);
+    }
+#endif
+
+    if (options.Prefault && Data)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        size_t const pageSize = Platform::PageSize();
+        volatile char sink = 0;
+        for (size_t offset = 0; offset < Size; offset += pageSize)
+            sink += Data[offset];
+
+        PrefaultSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Valid = true;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+    if (Data)
+        UnmapViewOfFile(Data);
+    if (Mapping)
+        CloseHandle(Mapping);
+    if (File != INVALID_HANDLE_VALUE)
+        CloseHandle(File);
+#else
+    if (Data)
+        munmap((void*)Data, Size);
+#endif
+}
+
+bool MappedFile::GetFileSize(char const* path, size_t& size)
+{
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+        return false;
+    size = (size_t)(((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow);
+#else
+    struct stat status;
+    if (stat(path, &status) != 0)
+        return false;
+    size = (size_t)status.st_size;
+#endif
+    return true;
+}
+
+char const* MappedFile::GetAdviceName(Advice advice)
+{
+    static char const* const names[] = { "normal", "sequential", "random", "willneed" };
+    return names[advice];
+}
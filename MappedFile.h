@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+// Read only mapping of a whole file, so large inputs are paged in by the OS as the codecs
+// touch them instead of being copied into memory up front.
+class MappedFile
+{
+public:
+    enum Advice
+    {
+        Normal,
+        Sequential,
+        Random,
+        WillNeed,
+    };
+
+    struct Options
+    {
+        Advice Access = Sequential;
+        // touch every page right after mapping so faults aren't paid inside the codec
+        bool Prefault = false;
+    };
+
+    MappedFile(char const* path, Options const& options);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool IsValid() const { return Valid; }
+    char const* GetData() const { return Data; }
+    size_t GetSize() const { return Size; }
+
+    // Time it took to fault in every page when prefaulting, 0 otherwise.
+    double GetPrefaultSeconds() const { return PrefaultSeconds; }
+
+    static bool GetFileSize(char const* path, size_t& size);
+    static char const* GetAdviceName(Advice advice);
+
+private:
+    char const* Data;
+    size_t Size;
+    bool Valid;
+    double PrefaultSeconds;
+
+#if defined(_WIN32)
+    void* File;
+    void* Mapping;
+#endif
+};
@@ -0,0 +1,117 @@
+#include "MemoryTracker.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Every block starts with its size so frees can be counted as well. 16 bytes keeps the
+    // returned pointer aligned for any fundamental type.
+    size_t const HeaderSize = 16;
+
+    struct Counters
+    {
+        bool Active;
+        int64_t Live;
+        int64_t Peak;
+        size_t Bytes;
+        size_t Count;
+    };
+
+    thread_local Counters ThreadCounters;
+}
+
+void* MemoryTracker::Allocate(size_t size)
+{
+    char* block = (char*)malloc(size + HeaderSize);
+    if (!block)
+        return nullptr;
+
+    *(size_t*)block = size;
+
+    Counters& counters = ThreadCounters;
+    if (counters.Active)
+    {
+        counters.Bytes += size;
+        ++counters.Count;
+        counters.Live += size;
+        if (counters.Live > counters.Peak)
+            counters.Peak = counters.Live;
+    }
+
+    return block + HeaderSize;
+}
+
+void MemoryTracker::Free(void* address)
+{
+    if (!address)
+        return;
+
+    char* block = (char*)address - HeaderSize;
+
+    Counters& counters = ThreadCounters;
+    if (counters.Active)
+        counters.Live -= *(size_t*)block;
+
+    free(block);
+}
+
+void MemoryTracker::Begin()
+{
+    Counters& counters = ThreadCounters;
+    counters.Active = true;
+    counters.Live = 0;
+    counters.Peak = 0;
+    counters.Bytes = 0;
+    counters.Count = 0;
+}
+
+MemoryTracker::Stats MemoryTracker::End()
+{
+    Counters& counters = ThreadCounters;
+    counters.Active = false;
+
+    Stats stats;
+    stats.AllocatedBytes = counters.Bytes;
+    stats.Allocations = counters.Count;
+    stats.PeakBytes = (size_t)counters.Peak;
+    return stats;
+}
+
+#ifndef ZIPCOMPARE_NO_GLOBAL_NEW
+
+void* operator new(size_t size)
+{
+    void* address = MemoryTracker::Allocate(size ? size : 1);
+    if (!address)
+        throw std::bad_alloc();
+    return address;
+}
+
+void* operator new[](size_t size)
+{
+    void* address = MemoryTracker::Allocate(size ? size : 1);
+    if (!address)
+        throw std::bad_alloc();
+    return address;
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept
+{
+    return MemoryTracker::Allocate(size ? size : 1);
+}
+
+void* operator new[](size_t size, std::nothrow_t const&) noexcept
+{
+    return MemoryTracker::Allocate(size ? size : 1);
+}
+
+void operator delete(void* address) noexcept { MemoryTracker::Free(address); }
+void operator delete[](void* address) noexcept { MemoryTracker::Free(address); }
+void operator delete(void* address, size_t) noexcept { MemoryTracker::Free(address); }
+void operator delete[](void* address, size_t) noexcept { MemoryTracker::Free(address); }
+void operator delete(void* address, std::nothrow_t const&) noexcept { MemoryTracker::Free(address); }
+void operator delete[](void* address, std::nothrow_t const&) noexcept { MemoryTracker::Free(address); }
+
+#endif
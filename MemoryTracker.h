@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts heap use per thread. Everything that goes through the global operator new ends up
+// here, and codecs with allocation hooks (zlib) call Allocate/Free directly. Build with
+// ZIPCOMPARE_NO_GLOBAL_NEW if something else in the link already replaces operator new.
+namespace MemoryTracker
+{
+    struct Stats
+    {
+        size_t AllocatedBytes = 0;
+        size_t Allocations = 0;
+        size_t PeakBytes = 0;
+    };
+
+    void* Allocate(size_t size);
+    void Free(void* address);
+
+    // Starts counting allocations made by the calling thread, End returns what happened since.
+    // Peak is the highest number of bytes live at once that were allocated after Begin.
+    void Begin();
+    Stats End();
+}
@@ -0,0 +1,266 @@
+#include "PageAllocator.h"
+#include "MemoryTracker.h"
+
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+    // Allocations are carved out of big mappings, a huge page per small buffer would waste
+    // most of it. Anything over a quarter of a chunk gets a mapping of its own.
+    size_t const ChunkSize = 32 * 1024 * 1024;
+    size_t const Alignment = 64;
+
+    struct Chunk
+    {
+        char* Base;
+        size_t Size;
+        size_t Used;
+        size_t Live;
+        bool Shared;
+    };
+
+    PageAllocator::Options Settings;
+    bool Active = false;
+    std::mutex Lock;
+    std::vector<Chunk> Chunks;
+    size_t Fallbacks = 0;
+
+    size_t RoundUp(size_t size, size_t multiple) { return (size + multiple - 1) / multiple * multiple; }
+
+#if defined(_WIN32)
+    size_t HugePageSize()
+    {
+        size_t size = GetLargePageMinimum();
+        return size ? size : 2 * 1024 * 1024;
+    }
+
+    // large pages need SeLockMemoryPrivilege enabled on the process token
+    void EnableLockMemoryPrivilege()
+    {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+            return;
+
+        TOKEN_PRIVILEGES privileges = {};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+            AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr);
+        CloseHandle(token);
+    }
+
+    char* MapPages(size_t size)
+    {
+        DWORD node = Settings.NumaNode >= 0 ? (DWORD)Settings.NumaNode : NUMA_NO_PREFERRED_NODE;
+
+        if (Settings.Pages == PageAllocator::Explicit)
+        {
+            void* address = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+            if (address)
+                return (char*)address;
+        }
+
+        // windows has nothing like transparent huge pages, those count as a fallback too
+        if (Settings.Pages != PageAllocator::None)
+            ++Fallbacks;
+
+        return (char*)VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    }
+
+    void UnmapPages(char* address, size_t)
+    {
+        VirtualFree(address, 0, MEM_RELEASE);
+    }
+#else
+    size_t HugePageSize() { return 2 * 1024 * 1024; }
+    void EnableLockMemoryPrivilege() {}
+
+    // Binds before anything is touched so every page is faulted in on the node.
+    bool BindToNode(char* address, size_t size)
+    {
+#if defined(__linux__)
+        if (Settings.NumaNode < 0)
+            return true;
+
+        unsigned long mask = 1ul << Settings.NumaNode;
+        int const bind = 2; // MPOL_BIND, numaif.h isn't always installed
+        // the kernel reads one bit less than maxnode
+        return syscall(SYS_mbind, address, size, bind, &mask, sizeof(mask) * 8 + 1, 0) == 0;
+#else
+        (void)address;
+        (void)size;
+        return Settings.NumaNode < 0;
+#endif
+    }
+
+    char* MapPages(size_t size)
+    {
+        int const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_HUGETLB)
+        if (Settings.Pages == PageAllocator::Explicit)
+        {
+            void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (address != MAP_FAILED)
+            {
+                if (!BindToNode((char*)address, size))
+                    ++Fallbacks;
+                return (char*)address;
+            }
+        }
+#endif
+        if (Settings.Pages == PageAllocator::Explicit)
+            ++Fallbacks;
+
+        // over map and trim so the region starts on a huge page boundary, THP only backs
+        // aligned 2MB ranges
+        size_t const hugePage = HugePageSize();
+        void* mapping = mmap(nullptr, size + hugePage, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mapping == MAP_FAILED)
+            return nullptr;
+
+        char* start = (char*)mapping;
+        char* address = (char*)RoundUp((uintptr_t)start, hugePage);
+        if (address > start)
+            munmap(start, address - start);
+        munmap(address + size, start + size + hugePage - address - size);
+
+#if defined(MADV_HUGEPAGE)
+        if (Settings.Pages == PageAllocator::Transparent && madvise(address, size, MADV_HUGEPAGE) != 0)
+            ++Fallbacks;
+#else
+        if (Settings.Pages == PageAllocator::Transparent)
+            ++Fallbacks;
+#endif
+
+        if (!BindToNode(address, size))
+            ++Fallbacks;
+        return address;
+    }
+
+    void UnmapPages(char* address, size_t size)
+    {
+        munmap(address, size);
+    }
+#endif
+}
+
+void PageAllocator::Configure(Options const& options)
+{
+    assert(Chunks.empty());
+    Settings = options;
+    Active = options.Pages != None || options.NumaNode >= 0;
+
+    if (options.Pages == Explicit)
+        EnableLockMemoryPrivilege();
+}
+
+PageAllocator::Options const& PageAllocator::GetOptions()
+{
+    return Settings;
+}
+
+bool PageAllocator::IsActive()
+{
+    return Active;
+}
+
+void* PageAllocator::Allocate(size_t size)
+{
+    if (!Active)
+        return MemoryTracker::Allocate(size);
+
+    std::lock_guard<std::mutex> lock(Lock);
+
+    size = RoundUp(size ? size : 1, Alignment);
+
+    if (size > ChunkSize / 4)
+    {
+        size_t mappedSize = RoundUp(size, HugePageSize());
+        char* address = MapPages(mappedSize);
+        if (address)
+            Chunks.push_back(Chunk{ address, mappedSize, size, 1, false });
+        return address;
+    }
+
+    for (Chunk& chunk : Chunks)
+    {
+        if (chunk.Shared && chunk.Size - chunk.Used >= size)
+        {
+            char* address = chunk.Base + chunk.Used;
+            chunk.Used += size;
+            ++chunk.Live;
+            return address;
+        }
+    }
+
+    char* address = MapPages(ChunkSize);
+    if (address)
+        Chunks.push_back(Chunk{ address, ChunkSize, size, 1, true });
+    return address;
+}
+
+void PageAllocator::Free(void* address)
+{
+    if (!address)
+        return;
+
+    if (!Active)
+    {
+        MemoryTracker::Free(address);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(Lock);
+
+    for (size_t i = 0; i < Chunks.size(); ++i)
+    {
+        Chunk& chunk = Chunks[i];
+        if ((char*)address < chunk.Base || (char*)address >= chunk.Base + chunk.Size)
+            continue;
+
+        if (--chunk.Live == 0)
+        {
+            // shared chunks stay mapped and start over, otherwise codecs that init and end
+            // per call would pay for a fresh mapping and its page faults every time
+            if (chunk.Shared)
+                chunk.Used = 0;
+            else
+            {
+                UnmapPages(chunk.Base, chunk.Size);
+                Chunks.erase(Chunks.begin() + i);
+            }
+        }
+        return;
+    }
+    assert(false);
+}
+
+size_t PageAllocator::GetFallbacks()
+{
+    std::lock_guard<std::mutex> lock(Lock);
+    return Fallbacks;
+}
+
+char const* PageAllocator::GetHugePagesName(HugePages pages)
+{
+    switch (pages)
+    {
+    case Transparent: return "transparent";
+    case Explicit: return "explicit";
+    default: return "none";
+    }
+}
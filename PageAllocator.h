@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Backs codec buffers and codec internal allocations with huge pages and/or memory bound
+// to one NUMA node, so TLB misses and remote memory can be measured instead of guessed.
+// Configure once before anything is allocated. Without a policy everything goes to
+// MemoryTracker like any other heap allocation.
+class PageAllocator
+{
+public:
+    enum HugePages
+    {
+        None,
+        // ask the kernel to back aligned regions with huge pages when it can (linux THP)
+        Transparent,
+        // reserved huge pages (hugetlbfs, windows large pages), normal pages if none are free
+        Explicit,
+    };
+
+    struct Options
+    {
+        HugePages Pages = None;
+        int NumaNode = -1;
+    };
+
+    static void Configure(Options const& options);
+    static Options const& GetOptions();
+    static bool IsActive();
+
+    static void* Allocate(size_t size);
+    static void Free(void* address);
+
+    // Allocations that didn't get the pages or the node they asked for.
+    static size_t GetFallbacks();
+
+    static char const* GetHugePagesName(HugePages pages);
+
+    // Standard allocator over Allocate/Free for the containers codecs write into.
+    template<class T>
+    struct Allocator
+    {
+        typedef T value_type;
+
+        Allocator() {}
+        template<class U> Allocator(Allocator<U> const&) {}
+
+        T* allocate(size_t count)
+        {
+            void* address = PageAllocator::Allocate(count * sizeof(T));
+            if (!address)
+                throw std::bad_alloc();
+            return (T*)address;
+        }
+        void deallocate(T* address, size_t) { PageAllocator::Free(address); }
+
+        template<class U> bool operator==(Allocator<U> const&) const { return true; }
+        template<class U> bool operator!=(Allocator<U> const&) const { return false; }
+    };
+};
+
+typedef std::vector<char, PageAllocator::Allocator<char>> CodecBuffer;
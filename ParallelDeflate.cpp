@@ -0,0 +1,225 @@
+#include "ParallelDeflate.h"
+
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // how far back deflate can match, and so how much input primes each block
+    size_t const WindowSize = 32 * 1024;
+
+    // what every block adds to its input at worst: deflateBound's raw deflate overhead
+    // plus the empty stored block of a sync flush
+    size_t const BlockOverhead = 16;
+    size_t const GzipHeaderSize = 10;
+    size_t const TrailerSize = 8;
+
+    void InitStream(z_stream& stream, int level)
+    {
+        memset(&stream, 0, sizeof(stream));
+        deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    }
+
+    void PutBigEndian(unsigned char* dest, unsigned long value)
+    {
+        for (int i = 3; i >= 0; --i, value >>= 8)
+            dest[i] = (unsigned char)value;
+    }
+
+    void PutLittleEndian(unsigned char* dest, unsigned long value)
+    {
+        for (int i = 0; i < 4; ++i, value >>= 8)
+            dest[i] = (unsigned char)value;
+    }
+}
+
+ParallelDeflate::ParallelDeflate(unsigned threads, int level, Format format, size_t blockSize)
+    : Level(level)
+    , Type(format)
+    , BlockSize(std::max(blockSize, WindowSize))
+    , Stream(new z_stream)
+{
+    InitStream(*Stream, Level);
+    for (unsigned t = 1; t < threads; ++t)
+        Workers.push_back(std::thread(&ParallelDeflate::Work, this));
+}
+
+ParallelDeflate::~ParallelDeflate()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stop = true;
+    }
+    Wake.notify_all();
+    for (auto& worker : Workers)
+        worker.join();
+
+    deflateEnd(Stream.get());
+}
+
+size_t ParallelDeflate::BlockCount(size_t size) const
+{
+    // empty input still needs the final block
+    return std::max<size_t>((size + BlockSize - 1) / BlockSize, 1);
+}
+
+size_t ParallelDeflate::Bound(size_t size) const
+{
+    return size + (size >> 12) + (size >> 14) + (size >> 25) + BlockCount(size) * BlockOverhead + GzipHeaderSize + TrailerSize;
+}
+
+size_t ParallelDeflate::Compress(char const* source, size_t size, char* dest, size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Source = source;
+        Size = size;
+        Blocks.resize(BlockCount(size));
+        NextBlock = 0;
+        Finished = 0;
+        ++Generation;
+    }
+    // a single block isn't worth waking anyone for
+    if (Blocks.size() > 1)
+        Wake.notify_all();
+
+    CompressBlocks(*Stream);
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        Done.wait(lock, [this] { return Finished == Blocks.size(); });
+    }
+
+    // the blocks go out in order, their checksums are merged as if computed in one go
+    unsigned char* out = (unsigned char*)dest;
+    unsigned char header[GzipHeaderSize];
+    size_t headerSize = WriteHeader(header);
+    if (capacity < headerSize + TrailerSize)
+        return 0;
+    memcpy(out, header, headerSize);
+    size_t written = headerSize;
+
+    unsigned long check = Blocks[0].Check;
+    for (size_t i = 0; i < Blocks.size(); ++i)
+    {
+        Block const& block = Blocks[i];
+        if (capacity - written - TrailerSize < block.Data.size())
+            return 0;
+        memcpy(out + written, block.Data.data(), block.Data.size());
+        written += block.Data.size();
+
+        // combining isn't free for crc32, so the first block's checksum is taken as is
+        if (i > 0)
+        {
+            z_off_t length = (z_off_t)std::min(BlockSize, size - i * BlockSize);
+            check = Type == Gzip ? crc32_combine(check, block.Check, length) : adler32_combine(check, block.Check, length);
+        }
+    }
+
+    // gzip ends on the crc and the size mod 2^32, zlib on the adler32 alone
+    if (Type == Gzip)
+    {
+        PutLittleEndian(out + written, check);
+        PutLittleEndian(out + written + 4, (unsigned long)size);
+        return written + 8;
+    }
+    PutBigEndian(out + written, check);
+    return written + 4;
+}
+
+void ParallelDeflate::Work()
+{
+    z_stream stream;
+    InitStream(stream, Level);
+
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(Mutex);
+    for (;;)
+    {
+        Wake.wait(lock, [this, seen] { return Stop || Generation != seen; });
+        if (Stop)
+            break;
+
+        // a worker that wakes after the job is done finds no blocks left
+        seen = Generation;
+        lock.unlock();
+        CompressBlocks(stream);
+        lock.lock();
+    }
+    lock.unlock();
+
+    deflateEnd(&stream);
+}
+
+void ParallelDeflate::CompressBlocks(z_stream& stream)
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+    while (NextBlock < Blocks.size())
+    {
+        size_t index = NextBlock++;
+        lock.unlock();
+        CompressBlock(stream, index);
+        lock.lock();
+
+        if (++Finished == Blocks.size())
+            Done.notify_all();
+    }
+}
+
+void ParallelDeflate::CompressBlock(z_stream& stream, size_t index)
+{
+    size_t start = index * BlockSize;
+    size_t size = std::min(BlockSize, Size - start);
+    bool last = start + size == Size;
+    Block& block = Blocks[index];
+
+    deflateReset(&stream);
+    if (start > 0)
+    {
+        size_t window = std::min(start, WindowSize);
+        deflateSetDictionary(&stream, (Bytef const*)Source + start - window, (uInt)window);
+    }
+
+    Bytef const* input = (Bytef const*)Source + start;
+    block.Check = Type == Gzip ? crc32(0, input, (uInt)size) : adler32(1, input, (uInt)size);
+
+    // a sync flush ends every block but the last byte aligned, without the final block bit
+    block.Data.resize(size + (size >> 12) + (size >> 14) + BlockOverhead);
+    stream.next_in = (Bytef*)input;
+    stream.avail_in = (uInt)size;
+    size_t out = 0;
+    for (;;)
+    {
+        stream.next_out = block.Data.data() + out;
+        stream.avail_out = (uInt)(block.Data.size() - out);
+        int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        out = block.Data.size() - stream.avail_out;
+
+        if (last ? status == Z_STREAM_END : stream.avail_out != 0)
+            break;
+        block.Data.resize(block.Data.size() * 2);
+    }
+    block.Data.resize(out);
+}
+
+size_t ParallelDeflate::WriteHeader(unsigned char* dest) const
+{
+    int level = Level == Z_DEFAULT_COMPRESSION ? 6 : Level;
+
+    if (Type == Gzip)
+    {
+        // no name or time, XFL marks the fastest and the best levels like gzip does
+        unsigned char const header[GzipHeaderSize] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, (unsigned char)(level == 9 ? 2 : level == 1 ? 4 : 0), 255 };
+        memcpy(dest, header, GzipHeaderSize);
+        return GzipHeaderSize;
+    }
+
+    // 32K window deflate, FLEVEL set the way deflate sets it, then the FCHECK bits
+    unsigned flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    unsigned header = (0x78 << 8) | (flags << 6);
+    header += 31 - header % 31;
+    dest[0] = (unsigned char)(header >> 8);
+    dest[1] = (unsigned char)header;
+    return 2;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct z_stream_s;
+
+// Compresses one buffer into a single zlib or gzip stream on several cores, the way pigz
+// does. The input is cut into blocks that are deflated independently, each primed with
+// the 32K of input before it so matches still reach across the cut, and each ending on a
+// sync flush so the pieces concatenate into one deflate stream. The block checksums are
+// merged with adler32_combine or crc32_combine. Any inflate reads the result.
+class ParallelDeflate
+{
+public:
+    enum Format { Zlib, Gzip };
+
+    // threads counts the calling thread, which compresses blocks as well
+    ParallelDeflate(unsigned threads, int level, Format format, size_t blockSize = 128 * 1024);
+    ~ParallelDeflate();
+
+    // Largest stream Compress writes for size bytes of input.
+    size_t Bound(size_t size) const;
+
+    // Returns the stream size, 0 if it didn't fit in capacity.
+    size_t Compress(char const* source, size_t size, char* dest, size_t capacity);
+
+    unsigned GetThreads() const { return (unsigned)Workers.size() + 1; }
+
+private:
+    struct Block
+    {
+        std::vector<unsigned char> Data;
+        unsigned long Check;
+    };
+
+    size_t BlockCount(size_t size) const;
+    void Work();
+    void CompressBlocks(z_stream_s& stream);
+    void CompressBlock(z_stream_s& stream, size_t index);
+    size_t WriteHeader(unsigned char* dest) const;
+
+    int const Level;
+    Format const Type;
+    size_t const BlockSize;
+
+    // the current job, blocks are handed out and counted under Mutex
+    char const* Source = nullptr;
+    size_t Size = 0;
+    std::vector<Block> Blocks;
+    size_t NextBlock = 0;
+    size_t Finished = 0;
+    unsigned Generation = 0;
+    bool Stop = false;
+
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::condition_variable Done;
+    std::unique_ptr<z_stream_s> Stream;
+    std::vector<std::thread> Workers;
+};
@@ -0,0 +1,183 @@
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    struct CounterConfig
+    {
+        uint32_t Type;
+        uint64_t Config;
+        int Group;
+    };
+
+    uint64_t CacheMiss(uint64_t cache)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    CounterConfig GetConfig(PerfCounters::Counter counter)
+    {
+        switch (counter)
+        {
+        case PerfCounters::Cycles: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0 };
+        case PerfCounters::Instructions: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 };
+        case PerfCounters::BranchMisses: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0 };
+        case PerfCounters::L1DMisses: return { PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_L1D), 1 };
+        case PerfCounters::LLCMisses: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1 };
+        case PerfCounters::DTLBMisses: return { PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_DTLB), 1 };
+        default: return { PERF_TYPE_HARDWARE, 0, -1 };
+        }
+    }
+
+    int OpenCounter(CounterConfig const& config, int leader)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = config.Type;
+        attr.config = config.Config;
+        attr.disabled = leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    }
+}
+
+PerfCounters::PerfCounters()
+{
+    int groupSize[GroupCount] = {};
+    for (int group = 0; group < GroupCount; ++group)
+        Leaders[group] = -1;
+
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        CounterConfig config = GetConfig((Counter)i);
+        Group[i] = config.Group;
+        Values[i] = -1;
+
+        // a counter the PMU doesn't have just stays closed, the rest of its group still works
+        Files[i] = OpenCounter(config, Leaders[config.Group]);
+        if (Files[i] < 0)
+            continue;
+
+        if (Leaders[config.Group] == -1)
+            Leaders[config.Group] = Files[i];
+        Slot[i] = groupSize[config.Group]++;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        if (Files[i] >= 0)
+            close(Files[i]);
+    }
+}
+
+bool PerfCounters::IsAvailable() const
+{
+    for (int group = 0; group < GroupCount; ++group)
+    {
+        if (Leaders[group] >= 0)
+            return true;
+    }
+    return false;
+}
+
+void PerfCounters::Start()
+{
+    for (int group = 0; group < GroupCount; ++group)
+    {
+        if (Leaders[group] < 0)
+            continue;
+
+        ioctl(Leaders[group], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(Leaders[group], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void PerfCounters::Stop()
+{
+    for (int group = 0; group < GroupCount; ++group)
+    {
+        if (Leaders[group] >= 0)
+            ioctl(Leaders[group], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    for (int group = 0; group < GroupCount; ++group)
+    {
+        if (Leaders[group] >= 0)
+            ReadGroup(group);
+    }
+}
+
+void PerfCounters::ReadGroup(int group)
+{
+    // PERF_FORMAT_GROUP layout: count, time enabled, time running, then one value per member
+    uint64_t data[3 + CounterCount];
+    if (read(Leaders[group], data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)))
+        return;
+
+    uint64_t count = data[0];
+    double scale = data[2] ? (double)data[1] / data[2] : 0;
+
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        if (Group[i] == group && Files[i] >= 0 && (uint64_t)Slot[i] < count)
+            Values[i] = data[3 + Slot[i]] * scale;
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    for (int group = 0; group < GroupCount; ++group)
+        Leaders[group] = -1;
+
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        Files[i] = -1;
+        Group[i] = -1;
+        Slot[i] = 0;
+        Values[i] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters() {}
+bool PerfCounters::IsAvailable() const { return false; }
+void PerfCounters::Start() {}
+void PerfCounters::Stop() {}
+void PerfCounters::ReadGroup(int) {}
+
+#endif
+
+double PerfCounters::Get(Counter counter) const
+{
+    return Values[counter];
+}
+
+char const* PerfCounters::GetName(Counter counter)
+{
+    static char const* const Names[CounterCount] =
+    {
+        "cycles",
+        "instructions",
+        "branch_misses",
+        "l1d_misses",
+        "llc_misses",
+        "dtlb_misses",
+    };
+    return Names[counter];
+}
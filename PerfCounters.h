@@ -0,0 +1,48 @@
+#pragma once
+
+// Hardware performance counters for the calling thread, read through perf_event_open on
+// Linux. Elsewhere, or when the kernel refuses (perf_event_paranoid, VMs without a PMU),
+// IsAvailable returns false and every counter reads as unavailable.
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        DTLBMisses,
+        CounterCount
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool IsAvailable() const;
+
+    void Start();
+    void Stop();
+
+    // Value from the last Start/Stop, scaled up if the kernel had to multiplex the
+    // counters. Negative if the counter couldn't be opened.
+    double Get(Counter counter) const;
+
+    static char const* GetName(Counter counter);
+
+private:
+    PerfCounters(PerfCounters const&);
+    PerfCounters& operator=(PerfCounters const&);
+
+    void ReadGroup(int group);
+
+    // Counters are opened in two groups so each group fits in the PMU at the same time.
+    static int const GroupCount = 2;
+
+    int Leaders[GroupCount];
+    int Files[CounterCount];
+    int Group[CounterCount];
+    int Slot[CounterCount];
+    double Values[CounterCount];
+};
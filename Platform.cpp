@@ -0,0 +1,174 @@
+#include "Platform.h"
+
+#include <thread>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+unsigned Platform::CoreCount()
+{
+    unsigned count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+unsigned Platform::NumaNodeCount()
+{
+#if defined(_WIN32)
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? highest + 1 : 1;
+#elif defined(__linux__)
+    unsigned count = 0;
+    while (true)
+    {
+        struct stat status;
+        std::string path = "/sys/devices/system/node/node" + std::to_string(count);
+        if (stat(path.c_str(), &status) != 0)
+            break;
+        ++count;
+    }
+    return count ? count : 1;
+#else
+    return 1;
+#endif
+}
+
+bool Platform::PinThread(unsigned core)
+{
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+namespace
+{
+    // First line of a small sysfs file without the newline, empty if it can't be read.
+    std::string ReadLine(std::string const& path)
+    {
+        std::string line;
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file)
+            return line;
+
+        char buffer[256];
+        if (fgets(buffer, sizeof(buffer), file))
+            line = buffer;
+        fclose(file);
+
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.pop_back();
+        return line;
+    }
+
+    std::string CpuFile(unsigned core, char const* name)
+    {
+        return "/sys/devices/system/cpu/cpu" + std::to_string(core) + "/cpufreq/" + name;
+    }
+}
+
+bool Platform::IsIsolatedCore(unsigned core)
+{
+    // comma separated list of cores and ranges, e.g. "2-3,6"
+    std::string list = ReadLine("/sys/devices/system/cpu/isolated");
+    char const* i = list.c_str();
+    while (*i)
+    {
+        char* end;
+        unsigned first = strtoul(i, &end, 10);
+        unsigned last = first;
+        if (*end == '-')
+            last = strtoul(end + 1, &end, 10);
+        if (end == i)
+            break;
+
+        if (core >= first && core <= last)
+            return true;
+
+        i = *end == ',' ? end + 1 : end;
+    }
+    return false;
+}
+
+unsigned Platform::CpuFrequencyMHz(unsigned core)
+{
+    std::string khz = ReadLine(CpuFile(core, "scaling_cur_freq"));
+    return (unsigned)(strtoul(khz.c_str(), nullptr, 10) / 1000);
+}
+
+std::string Platform::ScalingGovernor(unsigned core)
+{
+    return ReadLine(CpuFile(core, "scaling_governor"));
+}
+
+size_t Platform::PageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+bool Platform::PageFaults(size_t& minor, size_t& major)
+{
+#if defined(__linux__)
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0)
+        return false;
+    minor = (size_t)usage.ru_minflt;
+    major = (size_t)usage.ru_majflt;
+    return true;
+#else
+    (void)minor;
+    (void)major;
+    return false;
+#endif
+}
+
+std::string Platform::HostName()
+{
+    char name[256] = {};
+#if defined(_WIN32)
+    DWORD size = sizeof(name);
+    if (!GetComputerNameA(name, &size))
+        return std::string();
+#else
+    if (gethostname(name, sizeof(name) - 1) != 0)
+        return std::string();
+#endif
+    return name;
+}
+
+bool Platform::MakeDirectory(char const* path)
+{
+#if defined(_WIN32)
+    return _mkdir(path) == 0 || errno == EEXIST;
+#else
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
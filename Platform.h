@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Thin wrappers over the OS specific bits the command line driver needs.
+namespace Platform
+{
+    unsigned CoreCount();
+
+    // Memory nodes on this machine, 1 if the OS doesn't say.
+    unsigned NumaNodeCount();
+
+    // Pins the calling thread to one logical core. Returns false if the OS refused or
+    // pinning isn't supported.
+    bool PinThread(unsigned core);
+
+    // Whether the kernel keeps the scheduler off this core (linux isolcpus), false if unknown.
+    bool IsIsolatedCore(unsigned core);
+
+    // Current clock of a core in MHz, 0 if it can't be read.
+    unsigned CpuFrequencyMHz(unsigned core);
+
+    // cpufreq governor of a core, e.g. "performance" or "powersave", empty if unknown.
+    std::string ScalingGovernor(unsigned core);
+
+    size_t PageSize();
+
+    // Page faults taken by the calling thread so far, false if the OS doesn't say.
+    bool PageFaults(size_t& minor, size_t& major);
+
+    // Network name of this machine, empty if unknown.
+    std::string HostName();
+
+    // Creates a single directory level, succeeds if it already exists.
+    bool MakeDirectory(char const* path);
+}
@@ -0,0 +1,289 @@
+#include "ResultsFile.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    // Recursive descent over the document, values we don't know about are skipped.
+    class Parser
+    {
+    public:
+        Parser(string const& text)
+            : Text(text)
+            , Position(0)
+        {
+        }
+
+        bool ParseRun(ResultsFile::Run& run)
+        {
+            if (!Expect('{'))
+                return false;
+
+            if (Peek() == '}')
+                return Expect('}');
+
+            do
+            {
+                string key;
+                if (!ParseString(key) || !Expect(':'))
+                    return false;
+
+                bool parsed;
+                if (key == "metadata")
+                    parsed = ParseMetadata(run.Metadata);
+                else if (key == "results")
+                    parsed = ParseResults(run.Results);
+                else
+                    parsed = SkipValue();
+
+                if (!parsed)
+                    return false;
+            }
+            while (Accept(','));
+
+            return Expect('}');
+        }
+
+        size_t GetPosition() const { return Position; }
+
+    private:
+        bool ParseMetadata(vector<pair<string, string>>& metadata)
+        {
+            if (!Expect('{'))
+                return false;
+            if (Accept('}'))
+                return true;
+
+            do
+            {
+                string key;
+                string value;
+                if (!ParseString(key) || !Expect(':') || !ParseString(value))
+                    return false;
+                metadata.push_back(make_pair(key, value));
+            }
+            while (Accept(','));
+
+            return Expect('}');
+        }
+
+        bool ParseResults(vector<BenchmarkResult>& results)
+        {
+            if (!Expect('['))
+                return false;
+            if (Accept(']'))
+                return true;
+
+            do
+            {
+                BenchmarkResult result;
+                if (!ParseResult(result))
+                    return false;
+                results.push_back(result);
+            }
+            while (Accept(','));
+
+            return Expect(']');
+        }
+
+        bool ParseResult(BenchmarkResult& result)
+        {
+            if (!Expect('{'))
+                return false;
+            if (Accept('}'))
+                return true;
+
+            do
+            {
+                string key;
+                if (!ParseString(key) || !Expect(':'))
+                    return false;
+
+                bool parsed;
+                if (key == "codec")
+                    parsed = ParseString(result.Codec);
+                else if (key == "file")
+                    parsed = ParseString(result.File);
+                else if (key == "pass")
+                    parsed = ParseString(result.Pass);
+                else if (key == "samples")
+                    parsed = ParseNumbers(result.Samples);
+                else
+                {
+                    double value;
+                    parsed = ParseNumber(value);
+                    result.AddMetric(key.c_str(), value);
+                }
+
+                if (!parsed)
+                    return false;
+            }
+            while (Accept(','));
+
+            return Expect('}');
+        }
+
+        bool ParseNumbers(vector<double>& values)
+        {
+            if (!Expect('['))
+                return false;
+            if (Accept(']'))
+                return true;
+
+            do
+            {
+                double value;
+                if (!ParseNumber(value))
+                    return false;
+                values.push_back(value);
+            }
+            while (Accept(','));
+
+            return Expect(']');
+        }
+
+        bool ParseNumber(double& value)
+        {
+            SkipSpace();
+            char const* start = Text.c_str() + Position;
+            char* end;
+            value = strtod(start, &end);
+            if (end == start)
+                return false;
+            Position += end - start;
+            return true;
+        }
+
+        bool ParseString(string& value)
+        {
+            if (!Expect('"'))
+                return false;
+
+            value.clear();
+            while (Position < Text.size() && Text[Position] != '"')
+            {
+                char c = Text[Position++];
+                if (c == '\\' && Position < Text.size())
+                {
+                    c = Text[Position++];
+                    if (c == 'u' && Position + 4 <= Text.size())
+                    {
+                        // WriteJson only escapes control characters this way
+                        c = (char)strtol(Text.substr(Position, 4).c_str(), nullptr, 16);
+                        Position += 4;
+                    }
+                    else if (c == 'n')
+                        c = '\n';
+                    else if (c == 't')
+                        c = '\t';
+                }
+                value += c;
+            }
+            return Expect('"');
+        }
+
+        bool SkipValue()
+        {
+            char c = Peek();
+            if (c == '"')
+            {
+                string value;
+                return ParseString(value);
+            }
+            if (c == '{' || c == '[')
+            {
+                char close = c == '{' ? '}' : ']';
+                Expect(c);
+                if (Accept(close))
+                    return true;
+                do
+                {
+                    if (c == '{')
+                    {
+                        string key;
+                        if (!ParseString(key) || !Expect(':'))
+                            return false;
+                    }
+                    if (!SkipValue())
+                        return false;
+                }
+                while (Accept(','));
+                return Expect(close);
+            }
+            for (char const* literal : { "true", "false", "null" })
+            {
+                if (Text.compare(Position, strlen(literal), literal) == 0)
+                {
+                    Position += strlen(literal);
+                    return true;
+                }
+            }
+            double value;
+            return ParseNumber(value);
+        }
+
+        void SkipSpace()
+        {
+            while (Position < Text.size() && isspace((unsigned char)Text[Position]))
+                ++Position;
+        }
+
+        char Peek()
+        {
+            SkipSpace();
+            return Position < Text.size() ? Text[Position] : 0;
+        }
+
+        bool Accept(char c)
+        {
+            if (Peek() != c)
+                return false;
+            ++Position;
+            return true;
+        }
+
+        bool Expect(char c)
+        {
+            return Accept(c);
+        }
+
+        string const& Text;
+        size_t Position;
+    };
+}
+
+string ResultsFile::Run::GetMetadata(char const* name) const
+{
+    for (auto const& value : Metadata)
+    {
+        if (value.first == name)
+            return value.second;
+    }
+    return string();
+}
+
+bool ResultsFile::Read(char const* path, Run& run)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        fprintf(stderr, "couldn't open %s\n", path);
+        return false;
+    }
+
+    stringstream text;
+    text << in.rdbuf();
+    string const content = text.str();
+
+    Parser parser(content);
+    if (!parser.ParseRun(run))
+    {
+        fprintf(stderr, "%s isn't a results file, parsing stopped at byte %zu\n", path, parser.GetPosition());
+        return false;
+    }
+    return true;
+}
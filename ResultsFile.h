@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Benchmark.h"
+
+// Reads back the json the driver writes, so saved runs can be compared later. Only the
+// subset of json that WriteJson produces needs to round trip.
+namespace ResultsFile
+{
+    struct Run
+    {
+        vector<pair<string, string>> Metadata;
+        vector<BenchmarkResult> Results;
+
+        string GetMetadata(char const* name) const;
+    };
+
+    // False with a message on stderr if the file can't be read or parsed.
+    bool Read(char const* path, Run& run);
+}
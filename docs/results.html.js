@@ -71,4 +71,52 @@ function CreateChart(chartConfig) {
     });
 }
 
+/*
+var latencyConfig = {
+  test: "Test Name",
+  id: "canvasID",
+  codecs: [
+    {
+      name: "First Codec"
+      latencies: [p50, p99, p99.9, max] in microseconds
+      color: "rgba(75,192,192,0.4)",
+    }
+  ]
+};
+*/
+function CreateLatencyChart(chartConfig) {
+    var data = {
+        labels: ["p50", "p99", "p99.9", "max"],
+        datasets: []
+    };
 
+    chartConfig.codecs.forEach(function (e) {
+        data.datasets.push({
+            label: e.name,
+            backgroundColor: e.color,
+            borderColor: e.color,
+            borderWidth: 1,
+            data: e.latencies
+        });
+    });
+
+    var options = {
+        title: {
+            text: chartConfig.test
+        },
+        scales: {
+            yAxes: [{
+                type: 'logarithmic',
+                scaleLabel: { display: true, labelString: 'us per call' }
+            }]
+        }
+    };
+
+    var ctx = document.getElementById(chartConfig.id);
+
+    new Chart(ctx, {
+        type: 'bar',
+        data: data,
+        options: options
+    });
+}
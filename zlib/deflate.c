@@ -83,6 +83,7 @@ local block_state deflate_slow   OF((deflate_state *s, int flush));
 #endif
 local block_state deflate_rle    OF((deflate_state *s, int flush));
 local block_state deflate_huff   OF((deflate_state *s, int flush));
+local block_state deflate_quick  OF((deflate_state *s, int flush));
 local void lm_init        OF((deflate_state *s));
 local void putShortMSB    OF((deflate_state *s, uInt b));
 local void flush_pending  OF((z_streamp strm));
@@ -94,6 +95,7 @@ local unsigned read_buf   OF((z_streamp strm, Bytef *buf, unsigned size));
 #else
 local uInt longest_match  OF((deflate_state *s, IPos cur_match));
 #endif
+local uInt quick_match    OF((deflate_state *s, IPos cur_match));
 
 #ifdef ZLIB_DEBUG
 local  void check_match OF((deflate_state *s, IPos start, IPos match,
@@ -162,6 +164,87 @@ local const config configuration_table[10] = {
  */
 #define UPDATE_HASH(s,h,c) (h = (((h)<<s->hash_shift) ^ (c)) & s->hash_mask)
 
+/* ===========================================================================
+ * Compute the hash key of the string at str into s->ins_h, and prime ins_h
+ * before the first string of a run (HASH_STRING is then called for every
+ * following position in order).
+ * Unless compiled with -DROLLING_HASH, the key is not rolled from the
+ * previous one: the four bytes at str are loaded at once and hashed with the
+ * SSE4.2 crc32 instruction when the processor has it, or with a
+ * multiplicative hash otherwise. Both spread the strings over the whole
+ * table, and strings that only share their first three bytes no longer share
+ * a chain, so longest_match() walks far fewer candidates that can't win. The
+ * cost is that a three byte match is only found when it hashes with its
+ * fourth byte, and that the output depends on which hash the processor got.
+ * The load reads one byte past the last string inserted; like the reads past
+ * the lookahead in longest_match(), that byte is initialized by fill_window.
+ */
+#if !defined(ROLLING_HASH) && (!defined(Z_U4) || MIN_MATCH != 3)
+#  define ROLLING_HASH  /* needs a 32-bit type to load the string into */
+#endif
+
+#ifdef ROLLING_HASH
+#define HASH_STRING(s, str) \
+    UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)])
+#define RESET_HASH(s, str) \
+    (s->ins_h = s->window[str], UPDATE_HASH(s, s->ins_h, s->window[(str) + 1]))
+#else
+#  if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#    include <intrin.h>
+#    define CRC32C_HASH
+#  elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#    include <cpuid.h>
+#    define CRC32C_HASH
+#  endif
+#define HASH_STRING(s, str) (s->ins_h = hash_string(s, str))
+#define RESET_HASH(s, str)
+
+#ifdef CRC32C_HASH
+/* ===========================================================================
+ * Return true if the processor has the SSE4.2 crc32 instruction. Asked once
+ * per stream by deflateInit2_, nothing is shared between threads.
+ */
+local int have_crc32c()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] >> 20) & 1;
+#else
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx >> 20) & 1);
+#endif
+}
+#endif
+
+/* ===========================================================================
+ * Hash the four bytes at str with the function picked in deflateInit2_.
+ * The crc32 instruction is issued inline rather than through the intrinsic
+ * for gcc and clang, which would need the whole file built for SSE4.2.
+ */
+local uInt hash_string(s, str)
+    deflate_state *s;
+    uInt str;
+{
+    Z_U4 val;
+
+    zmemcpy(&val, s->window + str, sizeof(val));
+#ifdef CRC32C_HASH
+    if (s->hash_crc) {
+#ifdef _MSC_VER
+        val = _mm_crc32_u32(0, val);
+#else
+        Z_U4 crc = 0;
+        __asm__("crc32l %1, %0" : "+r" (crc) : "rm" (val));
+        val = crc;
+#endif
+        return (uInt)val & s->hash_mask;
+    }
+#endif
+    return (uInt)((val * 2654435761U) >> (32 - s->hash_bits));
+}
+#endif
+
 
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
@@ -175,12 +258,12 @@ local const config configuration_table[10] = {
  */
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (HASH_STRING(s, str), \
     match_head = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #else
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (HASH_STRING(s, str), \
     match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #endif
@@ -197,30 +280,124 @@ local const config configuration_table[10] = {
  * Slide the hash table when sliding the window down (could be avoided with 32
  * bit values at the expense of memory usage). We slide even when level == 0 to
  * keep the hash table consistent if we switch back to level > 0 later.
+ * m >= wsize ? m - wsize : NIL is a saturating subtract, which SSE2, AVX2
+ * and NEON do for eight or sixteen entries per instruction. SSE2 and NEON
+ * are always there on the targets they are built for, AVX2 is used when
+ * cpuid says the processor and the OS support it. Define NO_VECTOR_SLIDE
+ * to keep the plain loop. Both tables have a power of two of at least 256
+ * entries, so no tail is left over.
  */
-local void slide_hash(s)
+#ifndef NO_VECTOR_SLIDE
+#  if defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SLIDE_SSE2
+#    if defined(_MSC_VER) || defined(__clang__) || \
+        (defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#      include <immintrin.h>
+#      define SLIDE_AVX2
+#    endif
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    include <arm_neon.h>
+#    define SLIDE_NEON
+#  endif
+#endif
+
+#ifdef SLIDE_AVX2
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#    define TARGET_AVX2
+#  else
+#    include <cpuid.h>
+#    define TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+/* ===========================================================================
+ * Return true if the processor has AVX2 and the OS saves the ymm registers.
+ * Asked once per stream by deflateInit2_, nothing is shared between threads.
+ */
+local int have_avx2()
+{
+    unsigned ecx1, ebx7, xcr0 = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    ecx1 = (unsigned)info[2];
+    __cpuidex(info, 7, 0);
+    ebx7 = (unsigned)info[1];
+    if ((ecx1 >> 27) & 1)
+        xcr0 = (unsigned)_xgetbv(0);
+#else
+    unsigned eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, 0) < 7) return 0;
+    __cpuid(1, eax, ebx, ecx, edx);
+    ecx1 = ecx;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    ebx7 = ebx;
+    if ((ecx1 >> 27) & 1)
+        __asm__("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+#endif
+    return ((ebx7 >> 5) & 1) && (xcr0 & 6) == 6;
+}
+
+TARGET_AVX2 local void slide_table_avx2(Posf *table, unsigned n, uInt wsize)
+{
+    __m256i w = _mm256_set1_epi16((short)wsize);
+    __m256i *p = (__m256i *)table;
+
+    for (n /= 16; n; n--, p++)
+        _mm256_storeu_si256(p, _mm256_subs_epu16(_mm256_loadu_si256(p), w));
+}
+#endif
+
+local void slide_table(s, table, n)
     deflate_state *s;
+    Posf *table;
+    unsigned n;
 {
-    unsigned n, m;
-    Posf *p;
     uInt wsize = s->w_size;
+#if defined(SLIDE_SSE2)
+    __m128i w;
+    __m128i *p;
+
+    Assert(n % 16 == 0, "table size not a multiple of 16");
+#ifdef SLIDE_AVX2
+    if (s->slide_avx2) {
+        slide_table_avx2(table, n, wsize);
+        return;
+    }
+#endif
+    w = _mm_set1_epi16((short)wsize);
+    p = (__m128i *)table;
+    for (n /= 8; n; n--, p++)
+        _mm_storeu_si128(p, _mm_subs_epu16(_mm_loadu_si128(p), w));
+#elif defined(SLIDE_NEON)
+    uint16x8_t w = vdupq_n_u16((uint16_t)wsize);
+
+    Assert(n % 16 == 0, "table size not a multiple of 16");
+    for (n /= 8; n; n--, table += 8)
+        vst1q_u16(table, vqsubq_u16(vld1q_u16(table), w));
+#else
+    unsigned m;
+    Posf *p = &table[n];
 
-    n = s->hash_size;
-    p = &s->head[n];
     do {
         m = *--p;
         *p = (Pos)(m >= wsize ? m - wsize : NIL);
     } while (--n);
-    n = wsize;
+#endif
+}
+
+local void slide_hash(s)
+    deflate_state *s;
+{
+    slide_table(s, s->head, s->hash_size);
 #ifndef FASTEST
-    p = &s->prev[n];
-    do {
-        m = *--p;
-        *p = (Pos)(m >= wsize ? m - wsize : NIL);
-        /* If n is not on any hash chain, prev[n] is garbage but
-         * its value will never be used.
-         */
-    } while (--n);
+    /* If n is not on any hash chain, prev[n] is garbage but its value will
+     * never be used.
+     */
+    slide_table(s, s->prev, s->w_size);
 #endif
 }
 
@@ -252,11 +429,6 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     int wrap = 1;
     static const char my_version[] = ZLIB_VERSION;
 
-    ushf *overlay;
-    /* We overlay pending_buf and d_buf+l_buf. This works since the average
-     * output size for (length,distance) codes is <= 24 bits.
-     */
-
     if (version == Z_NULL || version[0] != my_version[0] ||
         stream_size != sizeof(z_stream)) {
         return Z_VERSION_ERROR;
@@ -317,6 +489,16 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     s->hash_size = 1 << s->hash_bits;
     s->hash_mask = s->hash_size - 1;
     s->hash_shift =  ((s->hash_bits+MIN_MATCH-1)/MIN_MATCH);
+#ifdef CRC32C_HASH
+    s->hash_crc = have_crc32c();
+#else
+    s->hash_crc = 0;
+#endif
+#ifdef SLIDE_AVX2
+    s->slide_avx2 = have_avx2();
+#else
+    s->slide_avx2 = 0;
+#endif
 
     s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
     s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
@@ -326,9 +508,17 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
 
     s->lit_bufsize = 1 << (memLevel + 6); /* 16K elements by default */
 
-    overlay = (ushf *) ZALLOC(strm, s->lit_bufsize, sizeof(ush)+2);
-    s->pending_buf = (uchf *) overlay;
-    s->pending_buf_size = (ulg)s->lit_bufsize * (sizeof(ush)+2L);
+    /* We overlay pending_buf and sym_buf, as zlib 1.2.12 does. Symbols are
+     * three bytes each in sym_buf, lit_bufsize bytes into pending_buf, and
+     * a block is written from the start of pending_buf as they are read.
+     * The longest symbol is 31 bits, a far match in the fixed codes, so
+     * over lit_bufsize-1 symbols the output gains less than 7/8 of
+     * lit_bufsize on the reads and never reaches a symbol not yet sent.
+     * 1.2.11's separate distance and length arrays only had room for about
+     * half a block of those matches.
+     */
+    s->pending_buf = (uchf *) ZALLOC(strm, s->lit_bufsize, 4);
+    s->pending_buf_size = (ulg)s->lit_bufsize * 4;
 
     if (s->window == Z_NULL || s->prev == Z_NULL || s->head == Z_NULL ||
         s->pending_buf == Z_NULL) {
@@ -337,8 +527,12 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
         deflateEnd (strm);
         return Z_MEM_ERROR;
     }
-    s->d_buf = overlay + s->lit_bufsize/sizeof(ush);
-    s->l_buf = s->pending_buf + (1+sizeof(ush))*s->lit_bufsize;
+    s->sym_buf = s->pending_buf + s->lit_bufsize;
+    s->sym_end = (s->lit_bufsize - 1) * 3;
+    /* We avoid equality with lit_bufsize*3 because of wraparound at 64K
+     * on 16 bit machines and because stored blocks are restricted to
+     * 64K-1 bytes.
+     */
 
     s->level = level;
     s->strategy = strategy;
@@ -418,7 +612,7 @@ int ZEXPORT deflateSetDictionary (strm, dictionary, dictLength)
         str = s->strstart;
         n = s->lookahead - (MIN_MATCH-1);
         do {
-            UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+            HASH_STRING(s, str);
 #ifndef FASTEST
             s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
@@ -549,7 +743,7 @@ int ZEXPORT deflatePrime (strm, bits, value)
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
     s = strm->state;
-    if ((Bytef *)(s->d_buf) < s->pending_out + ((Buf_size + 7) >> 3))
+    if (s->sym_buf < s->pending_out + ((Buf_size + 7) >> 3))
         return Z_BUF_ERROR;
     do {
         put = Buf_size - s->bi_valid;
@@ -1000,6 +1194,8 @@ int ZEXPORT deflate (strm, flush)
         bstate = s->level == 0 ? deflate_stored(s, flush) :
                  s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
                  s->strategy == Z_RLE ? deflate_rle(s, flush) :
+                 s->strategy == Z_FIXED && s->level == 1 ?
+                     deflate_quick(s, flush) :
                  (*(configuration_table[s->level].func))(s, flush);
 
         if (bstate == finish_started || bstate == finish_done) {
@@ -1082,6 +1278,9 @@ int ZEXPORT deflateEnd (strm)
 
     status = strm->state->status;
 
+    Tracev((stderr, "\nmatch searches %lu, chain links %lu\n",
+            strm->state->match_searches, strm->state->chain_links));
+
     /* Deallocate in reverse order of allocations: */
     TRY_FREE(strm, strm->state->pending_buf);
     TRY_FREE(strm, strm->state->head);
@@ -1108,7 +1307,6 @@ int ZEXPORT deflateCopy (dest, source)
 #else
     deflate_state *ds;
     deflate_state *ss;
-    ushf *overlay;
 
 
     if (deflateStateCheck(source) || dest == Z_NULL) {
@@ -1128,8 +1326,7 @@ int ZEXPORT deflateCopy (dest, source)
     ds->window = (Bytef *) ZALLOC(dest, ds->w_size, 2*sizeof(Byte));
     ds->prev   = (Posf *)  ZALLOC(dest, ds->w_size, sizeof(Pos));
     ds->head   = (Posf *)  ZALLOC(dest, ds->hash_size, sizeof(Pos));
-    overlay = (ushf *) ZALLOC(dest, ds->lit_bufsize, sizeof(ush)+2);
-    ds->pending_buf = (uchf *) overlay;
+    ds->pending_buf = (uchf *) ZALLOC(dest, ds->lit_bufsize, 4);
 
     if (ds->window == Z_NULL || ds->prev == Z_NULL || ds->head == Z_NULL ||
         ds->pending_buf == Z_NULL) {
@@ -1143,8 +1340,7 @@ int ZEXPORT deflateCopy (dest, source)
     zmemcpy(ds->pending_buf, ss->pending_buf, (uInt)ds->pending_buf_size);
 
     ds->pending_out = ds->pending_buf + (ss->pending_out - ss->pending_buf);
-    ds->d_buf = overlay + ds->lit_bufsize/sizeof(ush);
-    ds->l_buf = ds->pending_buf + (1+sizeof(ush))*ds->lit_bufsize;
+    ds->sym_buf = ds->pending_buf + ds->lit_bufsize;
 
     ds->l_desc.dyn_tree = ds->dyn_ltree;
     ds->d_desc.dyn_tree = ds->dyn_dtree;
@@ -1212,6 +1408,9 @@ local void lm_init (s)
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
+#ifdef ZLIB_DEBUG
+    s->match_searches = s->chain_links = 0;
+#endif
 #ifndef FASTEST
 #ifdef ASMV
     match_init(); /* initialize the asm code */
@@ -1233,6 +1432,50 @@ local void lm_init (s)
 /* For 80x86 and 680x0, an optimized version will be provided in match.asm or
  * match.S. The code will be functionally equivalent.
  */
+
+/* On little-endian 64-bit targets with a count trailing zeros instruction,
+ * candidates are rejected on the four bytes ending at best_len and matches
+ * are compared eight bytes at a time: the first differing byte is the
+ * lowest set bit of the xor of two words, divided by eight. Define
+ * NO_WIDE_MATCH to use the byte (or UNALIGNED_OK) comparisons instead.
+ */
+#if !defined(NO_WIDE_MATCH) && defined(Z_U4) && MAX_MATCH == 258
+#  if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#    include <intrin.h>
+#    define WIDE_MATCH
+typedef unsigned __int64 match_word;
+local int first_difference(match_word diff)
+{
+    unsigned long bit;
+    _BitScanForward64(&bit, diff);
+    return (int)(bit >> 3);
+}
+#  elif defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__)) && \
+        defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#    define WIDE_MATCH
+typedef unsigned long long match_word;
+#    define first_difference(diff) (__builtin_ctzll(diff) >> 3)
+#  endif
+#endif
+
+#ifdef WIDE_MATCH
+local Z_U4 load_quad(p)
+    const Bytef *p;
+{
+    Z_U4 quad;
+    zmemcpy(&quad, p, sizeof(quad));
+    return quad;
+}
+
+local match_word load_word(p)
+    const Bytef *p;
+{
+    match_word word;
+    zmemcpy(&word, p, sizeof(word));
+    return word;
+}
+#endif
+
 local uInt longest_match(s, cur_match)
     deflate_state *s;
     IPos cur_match;                             /* current match */
@@ -1251,7 +1494,19 @@ local uInt longest_match(s, cur_match)
     Posf *prev = s->prev;
     uInt wmask = s->w_mask;
 
-#ifdef UNALIGNED_OK
+#if defined(WIDE_MATCH)
+    /* The four bytes ending at best_len, or at MIN_MATCH-1 while best_len is
+     * shorter, which it is after deflateParams switches levels mid-stream.
+     * strstart and cur_match are at least 1, so they start no more than a
+     * byte before scan and match. Like the byte loop, that byte is compared
+     * while best_len is 0 and masked off while it is 1 or 2.
+     */
+    register int end_len = best_len < MIN_MATCH-1 ? MIN_MATCH-1 : best_len;
+    register Z_U4 scan_end = load_quad(scan+end_len-3);
+    register Z_U4 end_mask = best_len > 0 && best_len < MIN_MATCH ?
+        0xffffff00 : 0xffffffff;
+    match_word diff;
+#elif defined(UNALIGNED_OK)
     /* Compare two bytes at a time. Note: this is not always beneficial.
      * Try with and without -DUNALIGNED_OK to check.
      */
@@ -1279,9 +1534,15 @@ local uInt longest_match(s, cur_match)
     if ((uInt)nice_match > s->lookahead) nice_match = (int)s->lookahead;
 
     Assert((ulg)s->strstart <= s->window_size-MIN_LOOKAHEAD, "need lookahead");
+#ifdef ZLIB_DEBUG
+    s->match_searches++;
+#endif
 
     do {
         Assert(cur_match < s->strstart, "no future");
+#ifdef ZLIB_DEBUG
+        s->chain_links++;
+#endif
         match = s->window + cur_match;
 
         /* Skip to next match if the match length cannot increase
@@ -1292,7 +1553,26 @@ local uInt longest_match(s, cur_match)
          * However the length of the match is limited to the lookahead, so
          * the output of deflate is not affected by the uninitialized values.
          */
-#if (defined(UNALIGNED_OK) && MAX_MATCH == 258)
+#if defined(WIDE_MATCH)
+        if ((load_quad(match+end_len-3) ^ scan_end) & end_mask) continue;
+
+        /* Compare eight bytes at a time from the start, which also covers the
+         * third byte hash_string() keys don't guarantee. Words cover the
+         * first 256 bytes and the last two are compared one by one, so like
+         * the byte loop nothing past strstart+257 is read.
+         */
+        len = 0;
+        do {
+            diff = load_word(scan+len) ^ load_word(match+len);
+            if (diff) break;
+            len += 8;
+        } while (len < MAX_MATCH-2);
+        if (diff)
+            len += first_difference(diff);
+        else
+            while (len < MAX_MATCH && scan[len] == match[len]) len++;
+
+#elif (defined(UNALIGNED_OK) && MAX_MATCH == 258)
         /* This code assumes sizeof(unsigned short) == 2. Do not use
          * UNALIGNED_OK if your compiler uses a different size.
          */
@@ -1308,6 +1588,10 @@ local uInt longest_match(s, cur_match)
          * necessary to put more guard bytes at the end of the window, or
          * to check more often for insufficient lookahead.
          */
+#ifndef ROLLING_HASH
+        /* hash_string() keys can collide whatever the third bytes are */
+        if (scan[2] != match[2]) continue;
+#endif
         Assert(scan[2] == match[2], "scan[2]?");
         scan++, match++;
         do {
@@ -1325,7 +1609,7 @@ local uInt longest_match(s, cur_match)
         len = (MAX_MATCH - 1) - (int)(strend-scan);
         scan = strend - (MAX_MATCH-1);
 
-#else /* UNALIGNED_OK */
+#else /* WIDE_MATCH, UNALIGNED_OK */
 
         if (match[best_len]   != scan_end  ||
             match[best_len-1] != scan_end1 ||
@@ -1338,6 +1622,10 @@ local uInt longest_match(s, cur_match)
          * are always equal when the other bytes match, given that
          * the hash keys are equal and that HASH_BITS >= 8.
          */
+#ifndef ROLLING_HASH
+        /* hash_string() keys can collide whatever the third bytes are */
+        if (match[1] != scan[2]) continue;
+#endif
         scan += 2, match++;
         Assert(*scan == *match, "match[2]?");
 
@@ -1356,13 +1644,17 @@ local uInt longest_match(s, cur_match)
         len = MAX_MATCH - (int)(strend - scan);
         scan = strend - MAX_MATCH;
 
-#endif /* UNALIGNED_OK */
+#endif /* WIDE_MATCH, UNALIGNED_OK */
 
         if (len > best_len) {
             s->match_start = cur_match;
             best_len = len;
             if (len >= nice_match) break;
-#ifdef UNALIGNED_OK
+#if defined(WIDE_MATCH)
+            end_len = best_len;
+            scan_end = load_quad(scan+end_len-3);
+            end_mask = 0xffffffff;
+#elif defined(UNALIGNED_OK)
             scan_end = *(ushf*)(scan+best_len-1);
 #else
             scan_end1  = scan[best_len-1];
@@ -1412,6 +1704,10 @@ local uInt longest_match(s, cur_match)
      * are always equal when the other bytes match, given that
      * the hash keys are equal and that HASH_BITS >= 8.
      */
+#ifndef ROLLING_HASH
+    /* hash_string() keys can collide whatever the third bytes are */
+    if (match[2] != scan[2]) return MIN_MATCH-1;
+#endif
     scan += 2, match += 2;
     Assert(*scan == *match, "match[2]?");
 
@@ -1437,6 +1733,40 @@ local uInt longest_match(s, cur_match)
 
 #endif /* FASTEST */
 
+/* ===========================================================================
+ * Return the length of the match at cur_match, the only candidate
+ * deflate_quick() looks at, or MIN_MATCH-1 if it is shorter than MIN_MATCH.
+ * As in longest_match(), all bytes are compared since the hash keys don't
+ * guarantee any of them, match_start is set and the length is limited to the
+ * lookahead.
+ */
+local uInt quick_match(s, cur_match)
+    deflate_state *s;
+    IPos cur_match;                             /* the one candidate */
+{
+    Bytef *scan = s->window + s->strstart;      /* current string */
+    Bytef *match = s->window + cur_match;       /* matched string */
+    int len = 0;                                /* length of the match */
+#ifdef WIDE_MATCH
+    match_word diff;
+
+    if ((load_quad(scan) ^ load_quad(match)) & 0xffffff) return MIN_MATCH-1;
+    do {
+        diff = load_word(scan+len) ^ load_word(match+len);
+        if (diff) break;
+        len += 8;
+    } while (len < MAX_MATCH-2);
+    if (diff)
+        len += first_difference(diff);
+    else
+#endif
+        while (len < MAX_MATCH && scan[len] == match[len]) len++;
+
+    if (len < MIN_MATCH) return MIN_MATCH-1;
+    s->match_start = cur_match;
+    return (uInt)len <= s->lookahead ? (uInt)len : s->lookahead;
+}
+
 #ifdef ZLIB_DEBUG
 
 #define EQUAL 0
@@ -1537,13 +1867,12 @@ local void fill_window(s)
         /* Initialize the hash value now that we have some input: */
         if (s->lookahead + s->insert >= MIN_MATCH) {
             uInt str = s->strstart - s->insert;
-            s->ins_h = s->window[str];
-            UPDATE_HASH(s, s->ins_h, s->window[str + 1]);
+            RESET_HASH(s, str);
 #if MIN_MATCH != 3
             Call UPDATE_HASH() MIN_MATCH-3 more times
 #endif
             while (s->insert) {
-                UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+                HASH_STRING(s, str);
 #ifndef FASTEST
                 s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
@@ -1889,8 +2218,7 @@ local block_state deflate_fast(s, flush)
             {
                 s->strstart += s->match_length;
                 s->match_length = 0;
-                s->ins_h = s->window[s->strstart];
-                UPDATE_HASH(s, s->ins_h, s->window[s->strstart+1]);
+                RESET_HASH(s, s->strstart);
 #if MIN_MATCH != 3
                 Call UPDATE_HASH() MIN_MATCH-3 more times
 #endif
@@ -1912,14 +2240,80 @@ local block_state deflate_fast(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
+/* ===========================================================================
+ * Same as above for level 1 with the Z_FIXED strategy, trading compression for
+ * speed: the hash table is probed once per position, no strings are inserted
+ * inside matches, and _tr_flush_block() writes the fixed codes without
+ * building any trees.
+ */
+local block_state deflate_quick(s, flush)
+    deflate_state *s;
+    int flush;
+{
+    IPos hash_head;       /* the one candidate */
+    int bflush;           /* set if current block must be flushed */
+
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        hash_head = NIL;
+        if (s->lookahead >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart, hash_head);
+        }
+
+        s->match_length = 0;
+        if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+            s->match_length = quick_match (s, hash_head);
+        }
+        if (s->match_length >= MIN_MATCH) {
+            check_match(s, s->strstart, s->match_start, s->match_length);
+
+            _tr_tally_dist(s, s->strstart - s->match_start,
+                           s->match_length - MIN_MATCH, bflush);
+
+            s->lookahead -= s->match_length;
+            s->strstart += s->match_length;
+            s->match_length = 0;
+            RESET_HASH(s, s->strstart);
+#if MIN_MATCH != 3
+            Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+        } else {
+            /* No match, output a literal byte */
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_tally_lit (s, s->window[s->strstart], bflush);
+            s->lookahead--;
+            s->strstart++;
+        }
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
 
 #ifndef FASTEST
 /* ===========================================================================
- * Same as above, but achieves better compression. We use a lazy
+ * Same as deflate_fast, but achieves better compression. We use a lazy
  * evaluation for matches: a match is finally adopted only if there is
  * no better match at the next window position.
  */
@@ -2043,7 +2437,7 @@ local block_state deflate_slow(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
@@ -2118,7 +2512,7 @@ local block_state deflate_rle(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
@@ -2157,7 +2551,7 @@ local block_state deflate_huff(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
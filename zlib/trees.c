@@ -146,6 +146,7 @@ local void send_tree      OF((deflate_state *s, ct_data *tree, int max_code));
 local int  build_bl_tree  OF((deflate_state *s));
 local void send_all_trees OF((deflate_state *s, int lcodes, int dcodes,
                               int blcodes));
+local ulg  fixed_len      OF((deflate_state *s));
 local void compress_block OF((deflate_state *s, const ct_data *ltree,
                               const ct_data *dtree));
 local int  detect_data_type OF((deflate_state *s));
@@ -226,6 +227,33 @@ local void send_bits(s, value, length)
 
 /* the arguments must not have side effects */
 
+/* ===========================================================================
+ * A 64-bit bit buffer for compress_fixed(), where the compiler has one. Up to
+ * 31 bits are added per symbol, and four bytes are written out whenever 32 or
+ * more are waiting, so it never holds more than 62.
+ */
+#if defined(_MSC_VER)
+#  define WIDE_BITS
+typedef unsigned __int64 wide_bits;
+#elif defined(__GNUC__) || \
+      (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+#  define WIDE_BITS
+typedef unsigned long long wide_bits;
+#endif
+
+#ifdef WIDE_BITS
+local void compress_fixed OF((deflate_state *s));
+
+#ifdef ZLIB_DEBUG
+#  define send_wide(s, value, length) \
+    (s->bits_sent += (ulg)(length), \
+     buf |= (wide_bits)(value) << valid, valid += (length))
+#else
+#  define send_wide(s, value, length) \
+    (buf |= (wide_bits)(value) << valid, valid += (length))
+#endif
+#endif
+
 /* ===========================================================================
  * Initialize the various 'constant' tables.
  */
@@ -416,7 +444,7 @@ local void init_block(s)
 
     s->dyn_ltree[END_BLOCK].Freq = 1;
     s->opt_len = s->static_len = 0L;
-    s->last_lit = s->matches = 0;
+    s->sym_next = s->matches = 0;
 }
 
 #define SMALLEST 1
@@ -924,32 +952,46 @@ void ZLIB_INTERNAL _tr_flush_block(s, buf, stored_len, last)
         if (s->strm->data_type == Z_UNKNOWN)
             s->strm->data_type = detect_data_type(s);
 
-        /* Construct the literal and distance trees */
-        build_tree(s, (tree_desc *)(&(s->l_desc)));
-        Tracev((stderr, "\nlit data: dyn %ld, stat %ld", s->opt_len,
-                s->static_len));
-
-        build_tree(s, (tree_desc *)(&(s->d_desc)));
-        Tracev((stderr, "\ndist data: dyn %ld, stat %ld", s->opt_len,
-                s->static_len));
-        /* At this point, opt_len and static_len are the total bit lengths of
-         * the compressed block data, excluding the tree representations.
-         */
-
-        /* Build the bit length tree for the above two trees, and get the index
-         * in bl_order of the last bit length code to send.
-         */
-        max_blindex = build_bl_tree(s);
-
-        /* Determine the best encoding. Compute the block lengths in bytes. */
-        opt_lenb = (s->opt_len+3+7)>>3;
-        static_lenb = (s->static_len+3+7)>>3;
+        if (s->strategy == Z_FIXED) {
+            /* Only the fixed codes or a stored block can be sent, so the trees
+             * aren't built. The fixed length is counted from the frequencies.
+             */
+            s->static_len = fixed_len(s);
+            Tracev((stderr, "\nfixed %lu stored %lu lit %u ", s->static_len,
+                    stored_len, s->sym_next / 3));
+            opt_lenb = static_lenb = (s->static_len+3+7)>>3;
 
-        Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
-                opt_lenb, s->opt_len, static_lenb, s->static_len, stored_len,
-                s->last_lit));
-
-        if (static_lenb <= opt_lenb) opt_lenb = static_lenb;
+        } else {
+            /* Construct the literal and distance trees */
+            build_tree(s, (tree_desc *)(&(s->l_desc)));
+            Tracev((stderr, "\nlit data: dyn %ld, stat %ld", s->opt_len,
+                    s->static_len));
+
+            build_tree(s, (tree_desc *)(&(s->d_desc)));
+            Tracev((stderr, "\ndist data: dyn %ld, stat %ld", s->opt_len,
+                    s->static_len));
+            /* At this point, opt_len and static_len are the total bit
+             * lengths of the compressed block data, excluding the tree
+             * representations.
+             */
+
+            /* Build the bit length tree for the above two trees, and get the
+             * index in bl_order of the last bit length code to send.
+             */
+            max_blindex = build_bl_tree(s);
+
+            /* Determine the best encoding. Compute the block lengths in
+             * bytes.
+             */
+            opt_lenb = (s->opt_len+3+7)>>3;
+            static_lenb = (s->static_len+3+7)>>3;
+
+            Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
+                    opt_lenb, s->opt_len, static_lenb, s->static_len,
+                    stored_len, s->sym_next / 3));
+
+            if (static_lenb <= opt_lenb) opt_lenb = static_lenb;
+        }
 
     } else {
         Assert(buf != (char*)0, "lost buf");
@@ -976,8 +1018,12 @@ void ZLIB_INTERNAL _tr_flush_block(s, buf, stored_len, last)
     } else if (s->strategy == Z_FIXED || static_lenb == opt_lenb) {
 #endif
         send_bits(s, (STATIC_TREES<<1)+last, 3);
+#ifdef WIDE_BITS
+        compress_fixed(s);
+#else
         compress_block(s, (const ct_data *)static_ltree,
                        (const ct_data *)static_dtree);
+#endif
 #ifdef ZLIB_DEBUG
         s->compressed_len += 3 + s->static_len;
 #endif
@@ -1016,8 +1062,9 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
     unsigned dist;  /* distance of matched string */
     unsigned lc;    /* match length-MIN_MATCH or unmatched char (if dist==0) */
 {
-    s->d_buf[s->last_lit] = (ush)dist;
-    s->l_buf[s->last_lit++] = (uch)lc;
+    s->sym_buf[s->sym_next++] = (uch)dist;
+    s->sym_buf[s->sym_next++] = (uch)(dist >> 8);
+    s->sym_buf[s->sym_next++] = (uch)lc;
     if (dist == 0) {
         /* lc is the unmatched char */
         s->dyn_ltree[lc].Freq++;
@@ -1035,9 +1082,9 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
 
 #ifdef TRUNCATE_BLOCK
     /* Try to guess if it is profitable to stop the current block here */
-    if ((s->last_lit & 0x1fff) == 0 && s->level > 2) {
+    if ((s->sym_next / 3 & 0x1fff) == 0 && s->level > 2) {
         /* Compute an upper bound for the compressed length */
-        ulg out_length = (ulg)s->last_lit*8L;
+        ulg out_length = (ulg)s->sym_next / 3 * 8L;
         ulg in_length = (ulg)((long)s->strstart - s->block_start);
         int dcode;
         for (dcode = 0; dcode < D_CODES; dcode++) {
@@ -1045,18 +1092,107 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
                 (5L+extra_dbits[dcode]);
         }
         out_length >>= 3;
-        Tracev((stderr,"\nlast_lit %u, in %ld, out ~%ld(%ld%%) ",
-               s->last_lit, in_length, out_length,
+        Tracev((stderr,"\nsymbols %u, in %ld, out ~%ld(%ld%%) ",
+               s->sym_next / 3, in_length, out_length,
                100L - out_length*100L/in_length));
-        if (s->matches < s->last_lit/2 && out_length < in_length/2) return 1;
+        if (s->matches < s->sym_next / 6 && out_length < in_length/2)
+            return 1;
     }
 #endif
-    return (s->last_lit == s->lit_bufsize-1);
-    /* We avoid equality with lit_bufsize because of wraparound at 64K
-     * on 16 bit machines and because stored blocks are restricted to
-     * 64K-1 bytes.
-     */
+    return (s->sym_next == s->sym_end);
+}
+
+/* ===========================================================================
+ * Return the number of bits the block data takes in the fixed codes, as
+ * build_tree() would have counted in static_len.
+ */
+local ulg fixed_len(s)
+    deflate_state *s;
+{
+    ulg len = 0;        /* bits so far */
+    int n;              /* iterates over the codes */
+
+    for (n = 0; n <= END_BLOCK; n++)
+        len += (ulg)s->dyn_ltree[n].Freq * static_ltree[n].Len;
+    for (n = 0; n < LENGTH_CODES; n++)
+        len += (ulg)s->dyn_ltree[n+LITERALS+1].Freq *
+               (static_ltree[n+LITERALS+1].Len + extra_lbits[n]);
+    for (n = 0; n < D_CODES; n++)
+        len += (ulg)s->dyn_dtree[n].Freq * (5 + extra_dbits[n]);
+    return len;
+}
+
+#ifdef WIDE_BITS
+/* ===========================================================================
+ * Send the block data compressed using the fixed codes, the same as
+ * compress_block() with static_ltree and static_dtree but through a 64-bit
+ * bit buffer: every symbol goes in whole, length and distance with their
+ * extra bits, and only complete bytes reach pending_buf.
+ */
+local void compress_fixed(s)
+    deflate_state *s;
+{
+    wide_bits buf = s->bi_buf;  /* bits not yet written */
+    int valid = s->bi_valid;    /* number of valid bits in buf */
+    unsigned dist;      /* distance of matched string */
+    int lc;             /* match length or unmatched char (if dist == 0) */
+    unsigned sx = 0;    /* running index in sym_buf */
+    unsigned code;      /* the code to send */
+    int extra;          /* number of extra bits to send */
+
+    if (s->sym_next != 0) do {
+        dist = s->sym_buf[sx++] & 0xff;
+        dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
+        lc = s->sym_buf[sx++];
+        if (dist == 0) {
+            send_wide(s, static_ltree[lc].Code, static_ltree[lc].Len);
+            Tracecv(isgraph(lc), (stderr," '%c' ", lc));
+        } else {
+            /* Here, lc is the match length - MIN_MATCH */
+            code = _length_code[lc];
+            send_wide(s, static_ltree[code+LITERALS+1].Code,
+                      static_ltree[code+LITERALS+1].Len);
+            extra = extra_lbits[code];
+            if (extra != 0) {
+                /* not for length 258, which isn't base_length[28] */
+                send_wide(s, lc - base_length[code], extra);
+            }
+            dist--; /* dist is now the match distance - 1 */
+            code = d_code(dist);
+            Assert (code < D_CODES, "bad d_code");
+
+            send_wide(s, static_dtree[code].Code, static_dtree[code].Len);
+            extra = extra_dbits[code];
+            if (extra != 0)
+                send_wide(s, dist - (unsigned)base_dist[code], extra);
+        } /* literal or match pair ? */
+
+        if (valid >= 32) {
+            put_byte(s, (Byte)buf);
+            put_byte(s, (Byte)(buf >> 8));
+            put_byte(s, (Byte)(buf >> 16));
+            put_byte(s, (Byte)(buf >> 24));
+            buf >>= 32;
+            valid -= 32;
+        }
+
+        /* Check that the overlay between pending_buf and sym_buf is ok: */
+        Assert(s->pending < s->lit_bufsize + sx, "pendingBuf overflow");
+
+    } while (sx < s->sym_next);
+
+    send_wide(s, static_ltree[END_BLOCK].Code, static_ltree[END_BLOCK].Len);
+
+    /* Leave less than 16 bits in bi_buf, as send_bits() does */
+    while (valid >= 16) {
+        put_short(s, (ush)buf);
+        buf >>= 16;
+        valid -= 16;
+    }
+    s->bi_buf = (ush)buf;
+    s->bi_valid = valid;
 }
+#endif
 
 /* ===========================================================================
  * Send the block data compressed using the given Huffman trees
@@ -1068,13 +1204,14 @@ local void compress_block(s, ltree, dtree)
 {
     unsigned dist;      /* distance of matched string */
     int lc;             /* match length or unmatched char (if dist == 0) */
-    unsigned lx = 0;    /* running index in l_buf */
+    unsigned sx = 0;    /* running index in sym_buf */
     unsigned code;      /* the code to send */
     int extra;          /* number of extra bits to send */
 
-    if (s->last_lit != 0) do {
-        dist = s->d_buf[lx];
-        lc = s->l_buf[lx++];
+    if (s->sym_next != 0) do {
+        dist = s->sym_buf[sx++] & 0xff;
+        dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
+        lc = s->sym_buf[sx++];
         if (dist == 0) {
             send_code(s, lc, ltree); /* send a literal byte */
             Tracecv(isgraph(lc), (stderr," '%c' ", lc));
@@ -1099,11 +1236,10 @@ local void compress_block(s, ltree, dtree)
             }
         } /* literal or match pair ? */
 
-        /* Check that the overlay between pending_buf and d_buf+l_buf is ok: */
-        Assert((uInt)(s->pending) < s->lit_bufsize + 2*lx,
-               "pendingBuf overflow");
+        /* Check that the overlay between pending_buf and sym_buf is ok: */
+        Assert(s->pending < s->lit_bufsize + sx, "pendingBuf overflow");
 
-    } while (lx < s->last_lit);
+    } while (sx < s->sym_next);
 
     send_code(s, END_BLOCK, ltree);
 }